@@ -0,0 +1,107 @@
+/**
+ * The scripted SSL client for the TLS session resumption example.
+ * It does not use the network, the SMTP server responses are generated from the commands and the handshake
+ * is simulated with the session tickets, so the full and resumed handshakes can be counted on any board or host.
+ */
+#ifndef MOCK_SSL_CLIENT_H
+#define MOCK_SSL_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+class MockSSLClient : public Client
+{
+public:
+  // The number of full and resumed (abbreviated) handshakes.
+  int fullHandshakes = 0, resumedHandshakes = 0;
+
+  // Reject the resumption of the session in the next handshakes e.g. the server restarted and the tickets are gone.
+  bool rejectResumption = false;
+
+  // Import the session ticket before the handshake, the empty ticket clears the session.
+  void setSession(const String &ticket) { session = ticket; }
+
+  // Export the session ticket that was issued in the last handshake.
+  String getSession() { return ticket; }
+
+  int connect(IPAddress ip, uint16_t port) override { return connect("", port); }
+
+  int connect(const char *host, uint16_t port) override
+  {
+    if (!handshake())
+      return 0;
+    conn = true;
+    rx = "220 mock.server ESMTP ready\r\n";
+    pos = 0;
+    return 1;
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+
+  size_t write(const uint8_t *buf, size_t size) override
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      line += (char)buf[i];
+      if (line.endsWith("\r\n"))
+      {
+        respond(line);
+        line.remove(0);
+      }
+    }
+    return size;
+  }
+
+  int available() override { return rx.length() - pos; }
+  int read() override { return pos < rx.length() ? (uint8_t)rx[pos++] : -1; }
+
+  int read(uint8_t *buf, size_t size) override
+  {
+    size_t i = 0;
+    while (i < size && pos < rx.length())
+      buf[i++] = rx[pos++];
+    return i;
+  }
+
+  int peek() override { return pos < rx.length() ? (uint8_t)rx[pos] : -1; }
+  void flush() override {}
+  void stop() override { conn = false; }
+  uint8_t connected() override { return conn; }
+  operator bool() override { return conn; }
+
+private:
+  String rx, line, session, ticket, issued;
+  unsigned int pos = 0, count = 0;
+  bool conn = false;
+
+  // The session is resumed when the imported ticket was issued by this server, a new ticket is issued after the handshake.
+  bool handshake()
+  {
+    if (session.length() && issued.indexOf("[" + session + "]") > -1)
+    {
+      if (rejectResumption)
+        return false;
+      resumedHandshakes++;
+    }
+    else
+      fullHandshakes++;
+
+    ticket = "ticket-" + String(++count);
+    issued += "[" + ticket + "]";
+    return true;
+  }
+
+  void respond(const String &cmd)
+  {
+    if (cmd.startsWith("EHLO"))
+      rx += "250-mock.server\r\n250-8BITMIME\r\n250 AUTH PLAIN LOGIN\r\n";
+    else if (cmd.startsWith("AUTH"))
+      rx += "235 2.7.0 Authentication successful\r\n";
+    else if (cmd.startsWith("QUIT"))
+      rx += "221 2.0.0 Bye\r\n";
+    else
+      rx += "250 2.0.0 OK\r\n";
+  }
+};
+
+#endif
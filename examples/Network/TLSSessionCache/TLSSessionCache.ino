@@ -0,0 +1,71 @@
+/**
+ * The example to resume the TLS session on reconnect with the ReadyTLSSessionCache.
+ * The MockSSLClient simulates the SMTP server and the session tickets without the network, it counts the full and
+ * resumed handshakes, so this example runs on any board.
+ * With the real SSL client, the TLSSessionCallback function exports and imports the session with the session API of
+ * the SSL library instead, see https://github.com/mobizt/ReadyMail/blob/main/resources/docs/ADVANCED.md#-tls-session-resumption
+ */
+#include <Arduino.h>
+#include "MockSSLClient.h"
+
+#define ENABLE_SMTP
+#include <ReadyMail.h>
+
+MockSSLClient ssl_client;
+SMTPClient smtp(ssl_client);
+
+bool sessionCb(Client &client, std::vector<uint8_t> &session, readymail_tls_session_mode mode)
+{
+  MockSSLClient &mock = (MockSSLClient &)client;
+  if (mode == readymail_tls_session_mode_apply)
+  {
+    // The empty session data are provided when no session was cached for the host.
+    String ticket;
+    for (size_t i = 0; i < session.size(); i++)
+      ticket += (char)session[i];
+    mock.setSession(ticket);
+    return true;
+  }
+
+  String ticket = mock.getSession();
+  if (ticket.length() == 0)
+    return false;
+  session.assign(ticket.c_str(), ticket.c_str() + ticket.length());
+  return true;
+}
+
+ReadyTLSSessionCache tlsCache(sessionCb);
+
+void connect(const char *label)
+{
+  smtp.connect("smtp.example.com", 465);
+  smtp.authenticate("user@example.com", "password", readymail_auth_password);
+  bool authenticated = smtp.isAuthenticated();
+  smtp.stop();
+  ReadyMail.printf("%s: authenticated: %s, full handshakes: %d, resumed handshakes: %d, cached sessions: %d\n", label,
+                   authenticated ? "yes" : "no", ssl_client.fullHandshakes, ssl_client.resumedHandshakes, (int)tlsCache.size());
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("ReadyMail, version " + String(READYMAIL_VERSION));
+
+  smtp.setTLSSessionCache(tlsCache);
+
+  connect("First connection"); // Full handshake, the session is cached.
+  connect("Reconnection");     // Resumed handshake.
+
+  // The server rejects the session, the failed connection removes the cached session.
+  ssl_client.rejectResumption = true;
+  connect("Rejected resumption");
+  ssl_client.rejectResumption = false;
+
+  connect("After rejection"); // Full handshake, the new session is cached.
+  connect("Reconnection");    // Resumed handshake.
+}
+
+void loop()
+{
+}
@@ -29,7 +29,7 @@
 WiFiClientSecure ssl_client;
 IMAPClient imap(ssl_client);
 
-bool otaErr = false;
+bool otaStarted = false;
 
 // For more information, see https://bit.ly/4h9JR7p
 void imapCb(IMAPStatus status)
@@ -37,6 +37,13 @@ void imapCb(IMAPStatus status)
     ReadyMail.printf("ReadyMail[imap][%d]%s\n", status.state, status.text.c_str());
 }
 
+// The decoded firmware data are written to the update partition directly.
+int otaWrite(const uint8_t *data, size_t size)
+{
+    // Returns -1 to stop the fetch when the update failed.
+    return Update.write((uint8_t *)data, size) == size ? size : -1;
+}
+
 // For more information, see https://bit.ly/3KLvz0y
 void dataCb(IMAPCallbackData &data)
 {
@@ -66,44 +73,29 @@ void dataCb(IMAPCallbackData &data)
                              data.fileInfo(i).filename.c_str(), data.fileInfo(i).mime.c_str(), data.fileInfo(i).charset.c_str(),
                              data.fileInfo(i).transferEncoding.c_str(), data.fileInfo(i).fileSize,
                              data.fetchOption(i) ? "yes" : "no", i == data.fileCount() - 1 ? "\n" : "");
+
+            if (data.fileInfo(i).mime == "application/octet-stream" && data.fileInfo(i).filename == "firmware.bin")
+            {
+                ReadyMail.printf("Performing OTA update...\n");
+                otaStarted = Update.begin(data.fileInfo(i).fileSize);
+
+                // The firmware data will be written with otaWrite function.
+                if (otaStarted)
+                    data.setPartSink(i, otaWrite);
+            }
         }
     }
     else if (data.event() == imap_data_event_fetch_body)
     {
-        // Showing the text content
-        if (data.fileInfo().mime == "application/octet-stream" && data.fileInfo().filename == "firmware.bin")
+        if (otaStarted && data.fileInfo().filename == "firmware.bin")
         {
-            if (data.fileChunk().index == 0) // Fist chunk
-            {
-                ReadyMail.printf("Performing OTA update...\n");
-                otaErr = !Update.begin(data.fileInfo().fileSize);
-
-                if (data.fileProgress().available)
-                    ReadyMail.printf("Downloading %s, %d of %d, %d %% completed\n", data.fileInfo().filename,
-                                     data.fileChunk().index + data.fileChunk().size, data.fileInfo().fileSize, data.fileProgress().value);
+            if (data.fileProgress().available)
+                ReadyMail.printf("Downloading %s, %d of %d, %d %% completed\n", data.fileInfo().filename.c_str(),
+                                 data.fileChunk().index + data.fileChunk().size, data.fileInfo().fileSize, data.fileProgress().value);
 
-                if (!otaErr)
-                    otaErr = Update.write((uint8_t *)data.fileChunk().data, data.fileChunk().size) != data.fileChunk().size;
-            }
-            else if (!data.fileChunk().isComplete)
+            if (data.fileChunk().isComplete) // Last chunk
             {
-                if (!otaErr)
-                    otaErr = Update.write((uint8_t *)data.fileChunk().data, data.fileChunk().size) != data.fileChunk().size;
-
-                if (data.fileProgress().available)
-                    ReadyMail.printf("Downloading %s, %d of %d, %d %% completed\n", data.fileInfo().filename,
-                                     data.fileChunk().index + data.fileChunk().size, data.fileInfo().fileSize, data.fileProgress().value);
-            }
-            else // Last chunk
-            {
-                if (data.fileProgress().available)
-                    ReadyMail.printf("Downloading %s, %d of %d, %d %% completed\n", data.fileInfo().filename,
-                                     data.fileChunk().index + data.fileChunk().size, data.fileInfo().fileSize, data.fileProgress().value);
-
-                if (!otaErr)
-                    otaErr = !Update.end(true);
-
-                if (otaErr)
+                if (!Update.end(true))
                     ReadyMail.printf("OTA update failed.\n");
                 else
                 {
@@ -158,6 +150,10 @@ void setup()
     // If READ_ONLY_MODE is false, the flag /Seen will set to the fetched message.
     imap.select("INBOX", READ_ONLY_MODE);
 
+    // Fetch the firmware attachment with BINARY.PEEK if the server supports BINARY extension,
+    // the firmware is received without base64 encoding.
+    imap.setBinaryFetch(true);
+
     // Fetch the latest message in INBOX.
     imap.fetch(imap.getMailbox().msgCount, dataCb, NULL /* FileCallback */, AWAIT_MODE, MAX_CONTENT_SIZE);
 }
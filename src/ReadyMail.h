@@ -23,6 +23,7 @@
 #include <Client.h>
 #include "./core/ReadyTimer.h"
 #include "./core/ReadyCodec.h"
+#include "./core/ReadyDigest.h"
 #include "./core/Utils.h"
 
 #define READYMAIL_VERSION "0.4.0"
@@ -195,6 +196,20 @@ enum readymail_file_operating_mode
     readymail_file_mode_remove
 };
 
+// The strategy of waiting for the server response in the blocking (await) operations.
+enum readymail_wait_mode
+{
+    readymail_wait_yield,   // Poll the network client and yield in between (default).
+    readymail_wait_sleep,   // Sleep with delay() for the timeout hint when no data is available.
+    readymail_wait_callback // Wait in the WaitCallback function until the client is readable or the timeout hint is reached.
+};
+
+enum readymail_tls_session_mode
+{
+    readymail_tls_session_mode_apply, // Import the cached session data to the SSL client before the handshake.
+    readymail_tls_session_mode_store  // Export the session data from the SSL client after the handshake.
+};
+
 #if defined(READYCLIENT_SSL_CLIENT) && (defined(ENABLE_IMAP) || defined(ENABLE_SMTP))
 
 #if defined(ESP_SSLCLIENT_H) && !defined(READYCLIENT_TYPE_1)
@@ -234,13 +249,87 @@ namespace ReadyMailCallbackNS
     typedef void (*FileCallback)();
 #endif
     typedef void (*TLSHandshakeCallback)(bool &success);
+    typedef void (*WaitCallback)(Client &client, uint32_t timeoutMs);
+    typedef bool (*TLSSessionCallback)(Client &client, std::vector<uint8_t> &session, readymail_tls_session_mode mode);
+}
+
+struct readymail_wait_strategy
+{
+    readymail_wait_mode mode = readymail_wait_yield;
+    uint32_t timeout = 10;
+    ReadyMailCallbackNS::WaitCallback cb = NULL;
+
+    /** Wait for the incoming data before the next poll of the response.
+     *
+     * @param client The client that the response is read from.
+     * @param netClient The network client that is provided to the WaitCallback function.
+     */
+    void wait(Client *client, Client *netClient)
+    {
+        if (mode == readymail_wait_yield || !client || client->available() > 0)
+            return;
+        idle(netClient);
+    }
+
+    /** Wait without checking the incoming data e.g. when no data is available from all clients.
+     *
+     * @param netClient The network client that is provided to the WaitCallback function.
+     */
+    void idle(Client *netClient)
+    {
+        if (mode == readymail_wait_callback && cb && netClient)
+            cb(*netClient, timeout);
+        else if (mode == readymail_wait_yield)
+            sys_yield();
+        else
+            delay(timeout);
+    }
+};
+
+// The function that is called in every poll of the blocking (await) operations with the client that is waiting.
+typedef void (*readymail_await_hook_fn)(void *arg, const void *client);
+
+struct readymail_await_hook
+{
+    readymail_await_hook_fn fn = NULL;
+    void *arg = nullptr;
+    const void *task = nullptr; // The task (thread) that installed the hook.
+};
+
+// The identity of the running task (thread), the address of the thread local variable is unique per task.
+inline const void *rd_task_id()
+{
+#if defined(ESP32) || defined(ENABLE_WORKER)
+    static thread_local char id = 0;
+    return &id;
+#else
+    return nullptr;
+#endif
+}
+
+// The await hook that is shared by all clients e.g. for stepping the other clients while one client is blocking.
+inline readymail_await_hook &rd_await_hook()
+{
+    static readymail_await_hook hook;
+    return hook;
+}
+
+// Call the await hook from the blocking operation of client, the hook is skipped on the tasks other than the task
+// that installed it e.g. the ReadyMailWorker task, so the hook function is never run concurrently.
+inline void rd_await_step(const void *client)
+{
+    readymail_await_hook &hook = rd_await_hook();
+    if (hook.fn && hook.task == rd_task_id())
+        hook.fn(hook.arg, client);
 }
 
 #include "./core/ReadyError.h"
+#include "./core/ReadyTLSSession.h"
 
 #if defined(ENABLE_IMAP)
 #include "imap/MailboxInfo.h"
 #include "imap/IMAPClient.h"
+#include "imap/IMAPSessionPool.h"
 #endif
 
 #if defined(ENABLE_SMTP)
@@ -248,4 +337,8 @@ namespace ReadyMailCallbackNS
 #include "smtp/SMTPClient.h"
 #endif
 
+#include "./core/ReadyLoop.h"
+#include "./core/ReadyWorker.h"
+#include "./core/ReadyCoroutine.h"
+
 #endif
\ No newline at end of file
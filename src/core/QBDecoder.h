@@ -11,14 +11,6 @@
 
 #if defined(ENABLE_IMAP) || defined(ENABLE_SMTP)
 
-// Renesas devices
-#if defined(ARDUINO_UNOWIFIR4) || defined(ARDUINO_MINIMA) || defined(ARDUINO_PORTENTA_C33)
-#define XMAILER_STRSEP strsepImpl
-#define XMAILER_USE_STRSEP_IMPL
-#else
-#define XMAILER_STRSEP strsep
-#endif
-
 // Re-interpret cast
 template <typename To, typename From>
 static To rd_cast(From frm)
@@ -48,8 +40,6 @@ static void rd_free(void *ptr)
     }
 }
 
-#define strfcpy(A, B, C) strncpy(A, B, C), *(A + (C) - 1) = 0
-
 __attribute__((used)) static int Index_base64[128] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -70,212 +60,208 @@ __attribute__((used)) static int Index_hex[128] = {
     -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-#if defined(XMAILER_USE_STRSEP_IMPL)
-// This is strsep implementation because strdup may not available in some platform.
-static char *__attribute__((used)) strsepImpl(char **stringp, const char *delim)
-{
-  char *rv = *stringp;
-  if (rv)
-  {
-    *stringp += strcspn(*stringp, delim);
-    if (**stringp)
-      *(*stringp)++ = '\0';
-    else
-      *stringp = 0;
-  }
-  return rv;
-}
-
-#endif
-
 #define IsPrint(c) (isprint((unsigned char)(c)) || \
                     ((unsigned char)(c) >= 0xa0))
 
 #define hexval(c) Index_hex[(unsigned int)(c)]
 #define base64val(c) Index_base64[(unsigned int)(c)]
 
-// Quoted-printable and base64 decoder
+// The maximum bytes of UTF-8 output per input byte of charset conversion.
+#define QB_DECODER_CHARSET_EXPANSION 3
+
+// The charset conversion of the decoded encoded-word text to UTF-8.
+// Returns the number of bytes written to out or -1 when the charset is not supported.
+typedef int (*QBCharsetCallback)(const char *charset, size_t charsetLen, const char *in, size_t inLen, char *out, size_t outSize);
+
+// RFC 2047 quoted-printable and base64 encoded-word decoder.
+// The source is decoded in a single forward pass without heap allocation. The destination can be the source itself
+// (decoding in place) as the decoded text is never longer than the encoded text, the charset conversion is not used
+// in this case.
 class QBDecoder
 {
 
 public:
   QBDecoder() {};
   ~QBDecoder() {};
-  void decode(char *d, const char *s, size_t dlen)
+
+  // Set the charset conversion for the encoded-words that are not UTF-8 or US-ASCII.
+  // Without conversion, the non-printable characters of those encoded-words are replaced with '?'.
+  void setCharsetCallback(QBCharsetCallback cb) { charset_cb = cb; }
+
+  // Decode the encoded-words in s to d (dlen bytes including the terminating nul), returns the decoded length.
+  size_t decode(char *d, const char *s, size_t dlen)
   {
-    const char *q;
-    size_t n;
-    int found_encoded = 0;
+    if (dlen == 0)
+      return 0;
 
-    dlen--; /* save room for the terminal nul */
+    const bool in_place = d == s;
+    char *out = d, *end = d + dlen - 1;
+    // The position of white spaces after the last encoded-word that are removed when the next encoded-word follows.
+    char *space = nullptr;
 
-    while (*s && dlen > 0)
+    while (*s && out < end)
     {
-      const char *p;
-      if ((p = strstr(s, "=?")) == NULL ||
-          (q = strchr(p + 2, '?')) == NULL ||
-          (q = strchr(q + 1, '?')) == NULL ||
-          (q = strstr(q + 1, "?=")) == NULL)
+      qb_word word;
+      if (s[0] == '=' && s[1] == '?' && parseWord(s, word))
       {
-        /* no encoded words */
-        if (d != s)
-          strfcpy(d, s, dlen + 1);
-        return;
+        if (space)
+          out = space;
+        out += decodeWord(word, out, end - out, !in_place);
+        s = word.next;
+        space = out;
       }
-
-      if (p != s)
+      else
       {
-        n = (size_t)(p - s);
-        /* ignore spaces between encoded words */
-        if (!found_encoded || strspn(s, " \t\r\n") != n)
-        {
-          if (n > dlen)
-            n = dlen;
-          if (d != s)
-            memcpy(d, s, n);
-          d += n;
-          dlen -= n;
-        }
+        if (space && !(*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n'))
+          space = nullptr;
+        *out++ = *s++;
       }
-
-      decodeWord(d, p, dlen);
-      found_encoded = 1;
-      s = q + 2;
-      n = strlen(d);
-      dlen -= n;
-      d += n;
     }
-    *d = 0;
+
+    *out = 0;
+    return out - d;
   }
 
 private:
-  enum
+  struct qb_word
   {
-    ENCOTHER,
-    ENC7BIT,
-    ENC8BIT,
-    ENCQUOTEDPRINTABLE,
-    ENCBASE64,
-    ENCBINARY
+    const char *charset = nullptr, *text = nullptr, *text_end = nullptr, *next = nullptr;
+    size_t charset_len = 0;
+    char enc = 0;
   };
 
-  void decodeWord(char *d, const char *s, size_t dlen)
+  QBCharsetCallback charset_cb = NULL;
+
+  // Parse =?charset?encoding?text?= at s.
+  bool parseWord(const char *s, qb_word &word)
+  {
+    const char *p = s + 2;
+    word.charset = p;
+    while (*p && *p != '?' && *p != ' ')
+      p++;
+    if (*p != '?' || p == word.charset)
+      return false;
+
+    // RFC 2231 language e.g. utf-8*en
+    word.charset_len = p - word.charset;
+    for (size_t i = 0; i < word.charset_len; i++)
+    {
+      if (word.charset[i] == '*')
+        word.charset_len = i;
+    }
+
+    word.enc = toupper(p[1]);
+    if ((word.enc != 'Q' && word.enc != 'B') || p[2] != '?')
+      return false;
+
+    word.text = p + 3;
+    p = word.text;
+    while (*p && !(p[0] == '?' && p[1] == '='))
+      p++;
+    if (!*p)
+      return false;
+
+    word.text_end = p;
+    word.next = p + 2;
+    return true;
+  }
+
+  bool isUTF8(const qb_word &word)
+  {
+    return (word.charset_len == 5 && strncasecmp(word.charset, "utf-8", 5) == 0) || (word.charset_len == 8 && strncasecmp(word.charset, "us-ascii", 8) == 0);
+  }
+
+  size_t decodeWord(const qb_word &word, char *out, size_t size, bool convert)
+  {
+    const char *p = word.text;
+    uint32_t acc = 0;
+    int bits = 0;
+
+    if (isUTF8(word))
+      return decodeText(word, p, acc, bits, out, size);
+
+    if (!convert)
+    {
+      size_t n = decodeText(word, p, acc, bits, out, size);
+      filter(out, n);
+      return n;
+    }
+
+    // Decode the text in chunk and convert to UTF-8.
+    size_t n = 0;
+    char raw[64];
+    while (p < word.text_end)
+    {
+      size_t chunk = (size - n) / QB_DECODER_CHARSET_EXPANSION;
+      if (chunk == 0)
+        break;
+
+      size_t len = decodeText(word, p, acc, bits, raw, chunk < sizeof(raw) ? chunk : sizeof(raw));
+      int olen = charset_cb ? charset_cb(word.charset, word.charset_len, raw, len, out + n, size - n) : -1;
+      if (olen < 0)
+      {
+        filter(raw, len);
+        memcpy(out + n, raw, len);
+        n += len;
+      }
+      else
+        n += olen;
+    }
+    return n;
+  }
+
+  void filter(char *buf, size_t len)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      if (!IsPrint(buf[i]))
+        buf[i] = '?';
+    }
+  }
+
+  size_t decodeText(const qb_word &word, const char *&p, uint32_t &acc, int &bits, char *out, size_t size)
   {
-    char *p = safe_strdup(s);
-    char *pp = p;
-    char *end = p;
-    char *pd = d;
-    size_t len = dlen;
-    int enc = 0, filter = 0, count = 0, c1, c2, c3, c4;
-
-    while (pp != NULL)
+    size_t n = 0;
+    while (p < word.text_end && n < size)
     {
-      // See RFC2047.h
-      XMAILER_STRSEP(&end, "?");
-      count++;
-      switch (count)
+      unsigned char c = *p++;
+      if (word.enc == 'Q')
       {
-      case 2:
-        if (strcasecmp(pp, "utf-8") != 0)
+        if (c == '_')
+          out[n++] = ' ';
+        else if (c == '=' && word.text_end - p >= 2 && isHex(p[0]) && isHex(p[1]))
         {
-          filter = 1;
+          out[n++] = (hexval(p[0]) << 4) | hexval(p[1]);
+          p += 2;
         }
-        break;
-      case 3:
-        if (toupper(*pp) == 'Q')
-          enc = ENCQUOTEDPRINTABLE;
-        else if (toupper(*pp) == 'B')
-          enc = ENCBASE64;
         else
-          return;
-        break;
-      case 4:
-        if (enc == ENCQUOTEDPRINTABLE)
-        {
-          while (*pp && len > 0)
-          {
-            if (*pp == '_')
-            {
-              *pd++ = ' ';
-              len--;
-            }
-            else if (*pp == '=')
-            {
-              *pd++ = (hexval(pp[1]) << 4) | hexval(pp[2]);
-              len--;
-              pp += 2;
-            }
-            else
-            {
-              *pd++ = *pp;
-              len--;
-            }
-            pp++;
-          }
-          *pd = 0;
-        }
-        else if (enc == ENCBASE64)
+          out[n++] = c;
+      }
+      else
+      {
+        if (c == '=')
         {
-          while (*pp && len > 0)
-          {
-            c1 = base64val(pp[0]);
-            c2 = base64val(pp[1]);
-            *pd++ = (c1 << 2) | ((c2 >> 4) & 0x3);
-            if (--len == 0)
-              break;
-
-            if (pp[2] == '=')
-              break;
-
-            c3 = base64val(pp[2]);
-            *pd++ = ((c2 & 0xf) << 4) | ((c3 >> 2) & 0xf);
-            if (--len == 0)
-              break;
-
-            if (pp[3] == '=')
-              break;
-
-            c4 = base64val(pp[3]);
-            *pd++ = ((c3 & 0x3) << 6) | c4;
-            if (--len == 0)
-              break;
-
-            pp += 4;
-          }
-          *pd = 0;
+          p = word.text_end;
+          break;
         }
-        break;
-      }
 
-      pp = end;
-    }
+        int v = c < 128 ? base64val(c) : -1;
+        if (v < 0)
+          continue;
 
-    rd_free(&p);
-
-    if (filter)
-    {
-      pd = d;
-      while (*pd)
-      {
-        if (!IsPrint(*pd))
-          *pd = '?';
-        pd++;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8)
+        {
+          bits -= 8;
+          out[n++] = (acc >> bits) & 0xff;
+        }
       }
     }
-    return;
+    return n;
   }
-  char *safe_strdup(const char *s)
-  {
-    char *p;
-    size_t l;
 
-    if (!s || !*s)
-      return 0;
-    l = strlen(s) + 1;
-    p = rd_mem<char *>(l);
-    memcpy(p, s, l);
-    return (p);
-  }
+  bool isHex(char c) { return (unsigned char)c < 128 && hexval(c) > -1; }
 };
 #endif
 #endif // QB_DECODER_H
\ No newline at end of file
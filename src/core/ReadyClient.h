@@ -12,11 +12,14 @@
 #include <Arduino.h>
 #if defined(ENABLE_READYCLIENT) && defined(READYCLIENT_SSL_CLIENT)
 
+class ReadyTLSSessionCache;
+
 class ReadyClient
 {
 private:
     std::vector<readymail_port_function> ports;
     READYCLIENT_SSL_CLIENT *ssl_client = nullptr;
+    ReadyTLSSessionCache *session_cache = nullptr;
 
 public:
     /** ReadyClient class constructor.
@@ -42,8 +45,25 @@ public:
      *
      */
     void clearPorts() { ports.clear(); }
+
+    /** Set the TLS session cache for the session resumption.
+     *
+     * @param cache The ReadyTLSSessionCache class object that can be shared by many clients.
+     *
+     * The cached session of host and port is applied to the SSL client before the TLS handshake (SSL connection
+     * and STARTTLS) and it is updated after the handshake, the session resumption skips the full handshake.
+     */
+    void setSessionCache(ReadyTLSSessionCache &cache) { session_cache = &cache; }
+
+    /** Remove the TLS session cache.
+     *
+     */
+    void clearSessionCache() { session_cache = nullptr; }
     ~ReadyClient() {}
 
+    // Internal used functions.
+    ReadyTLSSessionCache *getSessionCache() { return session_cache; }
+
     // Internal used functions.
     READYCLIENT_SSL_CLIENT &getClient() { return *ssl_client; }
 
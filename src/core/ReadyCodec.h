@@ -9,6 +9,7 @@
 #include <Arduino.h>
 #include <stdarg.h>
 #include "QBDecoder.h"
+#include "ReadyCharset.h"
 
 #if defined(ENABLE_IMAP) || defined(ENABLE_SMTP)
 
@@ -549,24 +550,12 @@ static int rd_encode_unicode_utf8(char *out, uint32_t utf)
     }
 }
 
+// Deprecated, use rd_charset_decode() with rd_charset_tis_620.
+// The output buffer should be at least (len + 1) * 3 bytes.
 static void rd_dec_tis620_utf8(char *out, const char *in, size_t len)
 {
-    // output is the 3-byte value UTF-8
-    int j = 0;
-    for (size_t i = 0; i < len; i++)
-    {
-        if (in[i] < 0x80)
-            out[j++] = in[i];
-        else if ((in[i] >= 0xa0 && in[i] < 0xdb) || (in[i] > 0xde && in[i] < 0xfc))
-        {
-            int unicode = 0x0e00 + in[i] - 0xa0;
-            char o[5];
-            memset(o, 0, 5);
-            int r = rd_encode_unicode_utf8(o, unicode);
-            for (int x = 0; x < r; x++)
-                out[j++] = o[x];
-        }
-    }
+    int n = rd_charset_decode(rd_charset_tis_620, rd_cast<const uint8_t *>(in), len, out, len * 3);
+    out[n] = 0;
 }
 
 static int rd_dec_char(const char *s) { return 16 * hexval(*(s + 1)) + hexval(*(s + 2)); }
@@ -641,44 +630,15 @@ static char *rd_dec_8bit_utf8(const char *src)
     return decoded;
 }
 
+// Deprecated, use rd_charset_decode() with rd_charset_iso_8859_1.
+// The outlen and inlen are updated with the number of bytes that were written and read.
 static int rd_dec_latin1_utf8(unsigned char *out, int *outlen, const unsigned char *in, int *inlen)
 {
-    unsigned char *outstart = out;
-    const unsigned char *base = in;
-    const unsigned char *processed = in;
-    unsigned char *outend = out + *outlen;
-    const unsigned char *inend;
-    int bits;
-
-    inend = in + (*inlen);
-    while ((in < inend) && (out - outstart + 5 < *outlen))
-    {
-        unsigned int c = *in++;
-
-        /* assertion: c is a single UTF-4 value */
-        if (out >= outend)
-            break;
-        if (c < 0x80)
-        {
-            *out++ = c;
-            bits = -6;
-        }
-        else
-        {
-            *out++ = ((c >> 6) & 0x1F) | 0xC0;
-            bits = 0;
-        }
-
-        for (; bits >= 0; bits -= 6)
-        {
-            if (out >= outend)
-                break;
-            *out++ = ((c >> bits) & 0x3F) | 0x80;
-        }
-        processed = rd_cast<const unsigned char *>(in);
-    }
-    *outlen = out - outstart;
-    *inlen = processed - base;
+    int n = 0, i = 0;
+    while (i < *inlen && n + (in[i] < 0x80 ? 1 : 2) <= *outlen)
+        n += in[i++] < 0x80 ? 1 : 2;
+    *outlen = rd_charset_decode(rd_charset_iso_8859_1, in, i, rd_cast<char *>(out), *outlen);
+    *inlen = i;
     return (0);
 }
 
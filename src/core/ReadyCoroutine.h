@@ -0,0 +1,336 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The C++20 coroutine front-end over the async (non-blocking) operations of SMTPClient and IMAPClient.
+#ifndef READY_COROUTINE_H
+#define READY_COROUTINE_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_COROUTINE) && (defined(ENABLE_IMAP) || defined(ENABLE_SMTP))
+#if __cplusplus < 202002L || !__has_include(<coroutine>)
+#error "ENABLE_COROUTINE requires the C++20 coroutine support (-std=c++20)."
+#endif
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+/**
+ * The coroutine that provides the value with co_return and can be awaited by other coroutine.
+ *
+ * The coroutine is started when it is awaited or is spawned with ReadyMailScheduler::spawn().
+ */
+template <typename T = bool>
+class ReadyMailTask
+{
+public:
+    struct promise_type
+    {
+        T value{};
+        // The coroutine that awaits this coroutine, it is resumed when this coroutine is finished.
+        std::coroutine_handle<> continuation;
+
+        struct final_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        ReadyMailTask get_return_object() { return ReadyMailTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        final_awaiter final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = std::move(v); }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    struct awaiter
+    {
+        std::coroutine_handle<promise_type> h;
+        bool await_ready() { return !h || h.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+        {
+            h.promise().continuation = caller;
+            return h;
+        }
+        T await_resume() { return std::move(h.promise().value); }
+    };
+
+    ReadyMailTask() {}
+    explicit ReadyMailTask(std::coroutine_handle<promise_type> h) : h(h) {}
+    ReadyMailTask(ReadyMailTask &&other) noexcept : h(std::exchange(other.h, nullptr)) {}
+    ReadyMailTask &operator=(ReadyMailTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (h)
+                h.destroy();
+            h = std::exchange(other.h, nullptr);
+        }
+        return *this;
+    }
+    ReadyMailTask(const ReadyMailTask &) = delete;
+    ReadyMailTask &operator=(const ReadyMailTask &) = delete;
+    ~ReadyMailTask()
+    {
+        if (h)
+            h.destroy();
+    }
+
+    awaiter operator co_await() && noexcept { return awaiter{h}; }
+
+    bool done() const { return !h || h.done(); }
+
+    // The handle is owned by the caller e.g. ReadyMailScheduler.
+    std::coroutine_handle<promise_type> release() { return std::exchange(h, nullptr); }
+
+private:
+    std::coroutine_handle<promise_type> h;
+};
+
+class ReadyMailScheduler;
+
+/**
+ * The awaitable operation that was started in async mode, the awaiting coroutine is resumed by the ReadyMailScheduler
+ * when the operation is finished and the co_await result is the boolean status of operation.
+ */
+class ReadyMailOp
+{
+    friend class ReadyMailScheduler;
+
+public:
+    bool await_ready() { return !started; }
+    void await_suspend(std::coroutine_handle<> h);
+    bool await_resume() { return started && success; }
+
+private:
+    ReadyMailScheduler *sched = nullptr;
+#if defined(ENABLE_IMAP)
+    IMAPClient *imap = nullptr;
+#endif
+#if defined(ENABLE_SMTP)
+    SMTPClient *smtp = nullptr;
+#endif
+    bool started = false, success = false;
+    std::coroutine_handle<> handle;
+};
+
+/**
+ * Drives the async operations of the awaiting coroutines with the non-blocking loop of their clients.
+ *
+ * Many coroutines (mail flows) with different clients can run on one thread, each client should be used by one
+ * coroutine at a time. The scheduler waits with its wait strategy when no client has the incoming data.
+ */
+class ReadyMailScheduler
+{
+    friend class ReadyMailOp;
+
+public:
+    ReadyMailScheduler() {}
+    ~ReadyMailScheduler()
+    {
+        for (size_t i = 0; i < roots.size(); i++)
+            roots[i].destroy();
+    }
+
+    /** Start the coroutine that is owned by the scheduler until it is finished.
+     *
+     * @param task The ReadyMailTask coroutine.
+     */
+    template <typename T>
+    void spawn(ReadyMailTask<T> &&task)
+    {
+        std::coroutine_handle<> h = task.release();
+        if (!h)
+            return;
+        roots.push_back(h);
+        h.resume();
+    }
+
+    /** Perform the async processes of all awaiting operations once.
+     * This should be called in the loop when ReadyMailScheduler::run() is not used.
+     *
+     * @return number of coroutines that are not finished.
+     */
+    size_t loop()
+    {
+        std::vector<ReadyMailOp *> cur;
+        cur.swap(ops);
+        for (size_t i = 0; i < cur.size(); i++)
+        {
+            if (poll(*cur[i]))
+                cur[i]->handle.resume();
+            else
+                ops.push_back(cur[i]);
+        }
+
+        for (size_t i = 0; i < roots.size();)
+        {
+            if (roots[i].done())
+            {
+                roots[i].destroy();
+                roots.erase(roots.begin() + i);
+            }
+            else
+                i++;
+        }
+        return roots.size();
+    }
+
+    /** Run until all spawned coroutines are finished.
+     */
+    void run()
+    {
+        while (loop() > 0)
+        {
+            if (!dataAvailable())
+                wait.idle(netClient());
+        }
+    }
+
+    /** Set how ReadyMailScheduler::run() waits when no client has the incoming data.
+     *
+     * @param mode The readymail_wait_mode e.g. readymail_wait_yield, readymail_wait_sleep (default) or readymail_wait_callback.
+     * @param timeoutMs The timeout hint in milliseconds that is slept or provided to the WaitCallback function. The default is 10 ms.
+     * @param cb Optional. The WaitCallback function that is used with readymail_wait_callback mode, it is called with the network client of first awaiting operation.
+     */
+    void setWaitStrategy(readymail_wait_mode mode, uint32_t timeoutMs = 10, WaitCallback cb = NULL)
+    {
+        wait.mode = mode;
+        wait.timeout = timeoutMs;
+        wait.cb = cb;
+    }
+
+#if defined(ENABLE_IMAP)
+    /** Await the IMAPClient operation that was started in async mode (await parameter is false).
+     *
+     * @param client The IMAPClient.
+     * @param started The return value of the function that starts the operation.
+     * @return ReadyMailOp awaitable operation.
+     */
+    ReadyMailOp done(IMAPClient &client, bool started)
+    {
+        ReadyMailOp op;
+        op.sched = this;
+        op.imap = &client;
+        op.started = started;
+        return op;
+    }
+
+    ReadyMailOp connect(IMAPClient &client, const String &host, uint16_t port, IMAPResponseCallback responseCallback = NULL, bool ssl = true) { return done(client, client.connect(host, port, responseCallback, ssl, false)); }
+    ReadyMailOp authenticate(IMAPClient &client, const String &email, const String &param, readymail_auth_type auth) { return done(client, client.authenticate(email, param, auth, false)); }
+    ReadyMailOp select(IMAPClient &client, const String &mailbox, bool readOnly = true) { return done(client, client.select(mailbox, readOnly, false)); }
+    ReadyMailOp search(IMAPClient &client, const String &criteria, uint32_t searchLimit, bool recentSort, IMAPDataCallback dataCallback) { return done(client, client.search(criteria, searchLimit, recentSort, dataCallback, false)); }
+    ReadyMailOp fetch(IMAPClient &client, uint32_t number, IMAPDataCallback dataCallback, FileCallback fileCallback = NULL, uint32_t bodySizeLimit = 5 * 1024 * 1024, const String &downloadFolder = "") { return done(client, client.fetch(number, dataCallback, fileCallback, false, bodySizeLimit, downloadFolder)); }
+    ReadyMailOp fetchUID(IMAPClient &client, uint32_t uid, IMAPDataCallback dataCallback, FileCallback fileCallback = NULL, uint32_t bodySizeLimit = 5 * 1024 * 1024, const String &downloadFolder = "") { return done(client, client.fetchUID(uid, dataCallback, fileCallback, false, bodySizeLimit, downloadFolder)); }
+    ReadyMailOp logout(IMAPClient &client) { return done(client, client.logout(false)); }
+#endif
+
+#if defined(ENABLE_SMTP)
+    /** Await the SMTPClient operation that was started in async mode (await parameter is false).
+     *
+     * @param client The SMTPClient.
+     * @param started The return value of the function that starts the operation.
+     * @return ReadyMailOp awaitable operation.
+     */
+    ReadyMailOp done(SMTPClient &client, bool started)
+    {
+        ReadyMailOp op;
+        op.sched = this;
+        op.smtp = &client;
+        op.started = started;
+        return op;
+    }
+
+    ReadyMailOp connect(SMTPClient &client, const String &host, uint16_t port, SMTPResponseCallback responseCallback = NULL, bool ssl = true) { return done(client, client.connect(host, port, responseCallback, ssl, false)); }
+    ReadyMailOp authenticate(SMTPClient &client, const String &email, const String &param, readymail_auth_type auth) { return done(client, client.authenticate(email, param, auth, false)); }
+    // The message is composed with SMTPClient::getMessage() as it is required by the async sending.
+    ReadyMailOp send(SMTPClient &client, const String &notify = "") { return done(client, client.send(client.getMessage(), notify, false)); }
+    ReadyMailOp logout(SMTPClient &client) { return done(client, client.logout(false)); }
+#endif
+
+private:
+    std::vector<ReadyMailOp *> ops;
+    std::vector<std::coroutine_handle<>> roots;
+    readymail_wait_strategy wait{readymail_wait_sleep, 10, NULL};
+
+    // Perform the async process of the operation's client once, returns true when the operation is finished.
+    // The operation is finished with the same return codes that are checked by the awaitLoop() of clients.
+    bool poll(ReadyMailOp &op)
+    {
+#if defined(ENABLE_IMAP)
+        if (op.imap)
+        {
+            IMAPClient &c = *op.imap;
+            c.loop();
+            imap_function_return_code code = c.imap_ctx.server_status->ret;
+            if (code != ReadyMailIMAP::function_return_exit && code != ReadyMailIMAP::function_return_failure)
+                return false;
+            c.imap_ctx.server_status->state_info.state = imap_state_prompt;
+            op.success = code != ReadyMailIMAP::function_return_failure;
+            return true;
+        }
+#endif
+#if defined(ENABLE_SMTP)
+        if (op.smtp)
+        {
+            SMTPClient &c = *op.smtp;
+            c.loop();
+            smtp_function_return_code code = c.smtp_ctx.server_status->ret;
+            if (code != ReadyMailSMTP::function_return_exit && code != ReadyMailSMTP::function_return_failure)
+                return false;
+            c.smtp_ctx.server_status->state_info.state = smtp_state_prompt;
+            op.success = code != ReadyMailSMTP::function_return_failure;
+            return true;
+        }
+#endif
+        return true;
+    }
+
+    bool dataAvailable()
+    {
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+#if defined(ENABLE_IMAP)
+            if (ops[i]->imap && ops[i]->imap->imap_ctx.client && ops[i]->imap->imap_ctx.client->available() > 0)
+                return true;
+#endif
+#if defined(ENABLE_SMTP)
+            if (ops[i]->smtp && ops[i]->smtp->smtp_ctx.client && ops[i]->smtp->smtp_ctx.client->available() > 0)
+                return true;
+#endif
+        }
+        return false;
+    }
+
+    Client *netClient()
+    {
+        if (ops.size() == 0)
+            return nullptr;
+#if defined(ENABLE_IMAP)
+        if (ops[0]->imap)
+            return ops[0]->imap->netClient();
+#endif
+#if defined(ENABLE_SMTP)
+        if (ops[0]->smtp)
+            return ops[0]->smtp->smtp_ctx.client;
+#endif
+        return nullptr;
+    }
+};
+
+inline void ReadyMailOp::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    sched->ops.push_back(this);
+}
+
+#endif
+#endif
@@ -0,0 +1,672 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READY_DEFLATE_H
+#define READY_DEFLATE_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "QBDecoder.h"
+
+#if defined(ENABLE_IMAP_COMPRESS)
+
+// The size of compressed input buffer, it should be large enough to hold the dynamic Huffman block header.
+#if !defined(READYMAIL_INFLATE_INPUT_SIZE)
+#define READYMAIL_INFLATE_INPUT_SIZE 640
+#endif
+
+// The size of outgoing data buffer, the buffered data are compressed when the command line is complete or the buffer is full.
+#if !defined(READYMAIL_DEFLATE_CHUNK_SIZE)
+#define READYMAIL_DEFLATE_CHUNK_SIZE 1024
+#endif
+
+#define READYMAIL_DEFLATE_HASH_BITS 8
+#define READYMAIL_DEFLATE_MAX_MATCH 258
+
+static const uint16_t rd_deflate_len_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t rd_deflate_len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t rd_deflate_dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t rd_deflate_dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * The raw DEFLATE (RFC 1951) stream layer over the network client, used for IMAP COMPRESS=DEFLATE (RFC 4978).
+ *
+ * The incoming data is inflated into the window ring buffer (1 << windowBits bytes) which is also the read buffer.
+ * The outgoing data is buffered until the command line is complete (the written data ends with CRLF) or the buffer
+ * is full, then it is compressed with the fixed Huffman codes (or stored when it does not compress) and is flushed
+ * with an empty stored block so that the peer can process it immediately.
+ */
+class ReadyDeflate : public Client
+{
+public:
+    ReadyDeflate() {}
+    ~ReadyDeflate() { end(); }
+
+    /** Start the compression layer over the client.
+     *
+     * @param client The network client that was connected.
+     * @param windowBits The inflate window bits (9 to 15), the window should not be smaller than the peer's deflate window.
+     * @return boolean status of memory allocation.
+     */
+    bool begin(Client *client, uint8_t windowBits = 15)
+    {
+        end();
+        if (windowBits < 9 || windowBits > 15)
+            windowBits = 15;
+
+        this->client = client;
+        wsize = 1UL << windowBits;
+        win = rd_mem<uint8_t *>(wsize);
+        st = rd_mem<inflate_state *>(sizeof(inflate_state), true);
+        // The fixed Huffman codes are 9 bits at most per literal, plus block header, end of block and sync flush.
+        dbuf = rd_mem<uint8_t *>(READYMAIL_DEFLATE_CHUNK_SIZE);
+        out = rd_mem<uint8_t *>(READYMAIL_DEFLATE_CHUNK_SIZE + READYMAIL_DEFLATE_CHUNK_SIZE / 8 + 16);
+        head = rd_mem<int16_t *>(sizeof(int16_t) << READYMAIL_DEFLATE_HASH_BITS);
+        if (!win || !st || !dbuf || !out || !head)
+        {
+            end();
+            return false;
+        }
+        wpos = 0;
+        pending = 0;
+        dlen = 0;
+        err = false;
+        return true;
+    }
+
+    /** Stop the compression layer and free the memory.
+     */
+    void end()
+    {
+        rd_free(&win);
+        rd_free(&st);
+        rd_free(&dbuf);
+        rd_free(&out);
+        rd_free(&head);
+        pending = 0;
+        dlen = 0;
+    }
+
+    bool isActive() const { return win != nullptr; }
+
+    // The compressed stream was corrupted or it refers beyond the window.
+    bool failed() const { return err; }
+
+    Client *getClient() { return client; }
+
+    int connect(IPAddress ip, uint16_t port) { return client ? client->connect(ip, port) : 0; }
+    int connect(const char *host, uint16_t port) { return client ? client->connect(host, port) : 0; }
+#if defined(ESP32)
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) { return client ? client->connect(ip, port, timeout) : 0; }
+    int connect(const char *host, uint16_t port, int32_t timeout) { return client ? client->connect(host, port, timeout) : 0; }
+#endif
+    size_t write(uint8_t c) { return write(&c, 1); }
+
+    size_t write(const uint8_t *buf, size_t size)
+    {
+        if (!isActive())
+            return client ? client->write(buf, size) : 0;
+
+        // The number of bytes that were buffered and the bytes that were sent.
+        size_t buffered = 0, sent = 0;
+        while (buffered < size)
+        {
+            size_t len = size - buffered > READYMAIL_DEFLATE_CHUNK_SIZE - dlen ? READYMAIL_DEFLATE_CHUNK_SIZE - dlen : size - buffered;
+            memcpy(dbuf + dlen, buf + buffered, len);
+            dlen += len;
+            buffered += len;
+            if (dlen == READYMAIL_DEFLATE_CHUNK_SIZE)
+            {
+                if (!deflateBuffer())
+                    return sent;
+                sent = buffered;
+            }
+        }
+
+        // The command line is complete.
+        if (dlen > 1 && dbuf[dlen - 2] == '\r' && dbuf[dlen - 1] == '\n' && !deflateBuffer())
+            return sent;
+        return size;
+    }
+
+    int available()
+    {
+        if (!isActive())
+            return client ? client->available() : 0;
+        if (pending == 0)
+            pump();
+        return pending;
+    }
+
+    int read()
+    {
+        uint8_t c = 0;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int read(uint8_t *buf, size_t size)
+    {
+        if (!isActive())
+            return client ? client->read(buf, size) : -1;
+        if (pending == 0)
+            pump();
+
+        size_t i = 0;
+        while (i < size && pending > 0)
+            buf[i++] = win[(wpos - pending--) & (wsize - 1)];
+        return i;
+    }
+
+    int peek()
+    {
+        if (!isActive())
+            return client ? client->peek() : -1;
+        if (pending == 0)
+            pump();
+        return pending > 0 ? win[(wpos - pending) & (wsize - 1)] : -1;
+    }
+
+    void flush()
+    {
+        if (isActive())
+            deflateBuffer();
+        if (client)
+            client->flush();
+    }
+
+    void stop()
+    {
+        if (client)
+            client->stop();
+    }
+
+    uint8_t connected() { return client ? client->connected() : 0; }
+
+    operator bool() { return client && *client; }
+
+private:
+    enum inflate_mode
+    {
+        inflate_mode_header,
+        inflate_mode_stored,
+        inflate_mode_codes,
+        inflate_mode_done
+    };
+
+    struct huffman
+    {
+        uint16_t count[16];
+        uint16_t symbol[288];
+    };
+
+    struct inflate_state
+    {
+        huffman lencode, distcode;
+        uint8_t in[READYMAIL_INFLATE_INPUT_SIZE];
+        uint16_t in_len, in_pos;
+        uint32_t bitbuf, stored_len;
+        uint8_t bitcnt, mode, last;
+    };
+
+    Client *client = nullptr;
+    inflate_state *st = nullptr;
+    uint8_t *win = nullptr;
+    uint32_t wsize = 0, wpos = 0, pending = 0;
+    bool err = false;
+
+    // The outgoing data buffer and the hash table of match positions.
+    uint8_t *dbuf = nullptr;
+    uint32_t dlen = 0;
+    int16_t *head = nullptr;
+
+    // Bit writer for deflate output.
+    uint8_t *out = nullptr;
+    uint32_t out_len = 0, out_bitbuf = 0;
+    uint8_t out_bitcnt = 0;
+
+    // Read the available compressed data and inflate as much as the window allows.
+    // Keep reading while the input is available but not yet enough to decode the next symbol,
+    // the caller would see the partial line otherwise.
+    void pump()
+    {
+        int len = 0;
+        do
+        {
+            if (err || !client || st->mode == inflate_mode_done)
+                return;
+
+            if (st->in_pos > 0)
+            {
+                memmove(st->in, st->in + st->in_pos, st->in_len - st->in_pos);
+                st->in_len -= st->in_pos;
+                st->in_pos = 0;
+            }
+
+            len = client->available();
+            if (len > READYMAIL_INFLATE_INPUT_SIZE - st->in_len)
+                len = READYMAIL_INFLATE_INPUT_SIZE - st->in_len;
+            if (len > 0)
+            {
+                len = client->read(st->in + st->in_len, len);
+                if (len > 0)
+                    st->in_len += len;
+            }
+            inflate();
+        } while (pending == 0 && len > 0);
+    }
+
+    bool bits(uint8_t need, uint32_t &val)
+    {
+        while (st->bitcnt < need)
+        {
+            if (st->in_pos == st->in_len)
+                return false;
+            st->bitbuf |= (uint32_t)st->in[st->in_pos++] << st->bitcnt;
+            st->bitcnt += 8;
+        }
+        val = st->bitbuf & ((1UL << need) - 1);
+        st->bitbuf >>= need;
+        st->bitcnt -= need;
+        return true;
+    }
+
+    // Decode the symbol bit by bit with the canonical Huffman code counts.
+    // Returns -1 for more input needed, -2 for invalid code.
+    int decode(const huffman &h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++)
+        {
+            uint32_t b = 0;
+            if (!bits(1, b))
+                return -1;
+            code |= b;
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -2;
+    }
+
+    bool construct(huffman &h, const uint8_t *length, int n)
+    {
+        uint16_t offs[16];
+        memset(h.count, 0, sizeof(h.count));
+        for (int i = 0; i < n; i++)
+            h.count[length[i]]++;
+
+        if (h.count[0] == n)
+            return true;
+
+        int left = 1;
+        for (int len = 1; len < 16; len++)
+        {
+            left <<= 1;
+            left -= h.count[len];
+            if (left < 0)
+                return false;
+        }
+
+        offs[1] = 0;
+        for (int len = 1; len < 15; len++)
+            offs[len + 1] = offs[len] + h.count[len];
+
+        for (int i = 0; i < n; i++)
+        {
+            if (length[i] != 0)
+                h.symbol[offs[length[i]]++] = i;
+        }
+        return true;
+    }
+
+    void fixedTables()
+    {
+        uint8_t length[288];
+        int i = 0;
+        for (; i < 144; i++)
+            length[i] = 8;
+        for (; i < 256; i++)
+            length[i] = 9;
+        for (; i < 280; i++)
+            length[i] = 7;
+        for (; i < 288; i++)
+            length[i] = 8;
+        construct(st->lencode, length, 288);
+        for (i = 0; i < 30; i++)
+            length[i] = 5;
+        construct(st->distcode, length, 30);
+    }
+
+    // Returns 1 when done, 0 for more input needed and -1 for error.
+    int dynamicTables()
+    {
+        static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        uint8_t length[320];
+        uint32_t nlen = 0, ndist = 0, ncode = 0, v = 0;
+
+        if (!bits(5, nlen) || !bits(5, ndist) || !bits(4, ncode))
+            return 0;
+        nlen += 257;
+        ndist += 1;
+        ncode += 4;
+        if (nlen > 286 || ndist > 30)
+            return -1;
+
+        int i = 0;
+        for (; i < (int)ncode; i++)
+        {
+            if (!bits(3, v))
+                return 0;
+            length[order[i]] = v;
+        }
+        for (; i < 19; i++)
+            length[order[i]] = 0;
+
+        if (!construct(st->lencode, length, 19))
+            return -1;
+
+        i = 0;
+        while (i < (int)(nlen + ndist))
+        {
+            int symbol = decode(st->lencode);
+            if (symbol == -1)
+                return 0;
+            if (symbol < 0)
+                return -1;
+
+            if (symbol < 16)
+                length[i++] = symbol;
+            else
+            {
+                uint8_t len = 0;
+                uint32_t rep = 0;
+                if (symbol == 16)
+                {
+                    if (i == 0)
+                        return -1;
+                    len = length[i - 1];
+                    if (!bits(2, rep))
+                        return 0;
+                    rep += 3;
+                }
+                else if (symbol == 17)
+                {
+                    if (!bits(3, rep))
+                        return 0;
+                    rep += 3;
+                }
+                else
+                {
+                    if (!bits(7, rep))
+                        return 0;
+                    rep += 11;
+                }
+
+                if (i + rep > nlen + ndist)
+                    return -1;
+                while (rep--)
+                    length[i++] = len;
+            }
+        }
+
+        if (length[256] == 0 || !construct(st->lencode, length, nlen) || !construct(st->distcode, length + nlen, ndist))
+            return -1;
+        return 1;
+    }
+
+    void put(uint8_t c)
+    {
+        win[wpos++ & (wsize - 1)] = c;
+        pending++;
+    }
+
+    void inflate()
+    {
+        while (!err)
+        {
+            // Save the input position to restore when the input is not enough for the current step.
+            uint16_t in_pos = st->in_pos;
+            uint32_t bitbuf = st->bitbuf;
+            uint8_t bitcnt = st->bitcnt;
+            int ret = 1;
+
+            if (st->mode == inflate_mode_header)
+            {
+                uint32_t last = 0, type = 0;
+                ret = bits(1, last) && bits(2, type) ? 1 : 0;
+                if (ret)
+                {
+                    st->last = last;
+                    if (type == 0)
+                    {
+                        uint32_t len = 0, nlen = 0;
+                        st->bitbuf = 0;
+                        st->bitcnt = 0; // Go to byte boundary, the loaded bits are from the current byte only.
+                        ret = bits(16, len) && bits(16, nlen) ? 1 : 0;
+                        if (ret && len != (~nlen & 0xffff))
+                            ret = -1;
+                        st->stored_len = len;
+                        st->mode = inflate_mode_stored;
+                    }
+                    else if (type == 1)
+                    {
+                        fixedTables();
+                        st->mode = inflate_mode_codes;
+                    }
+                    else if (type == 2)
+                    {
+                        ret = dynamicTables();
+                        st->mode = inflate_mode_codes;
+                    }
+                    else
+                        ret = -1;
+                }
+
+                if (ret == 0)
+                    st->mode = inflate_mode_header;
+            }
+            else if (st->mode == inflate_mode_stored)
+            {
+                while (st->stored_len > 0 && st->in_pos < st->in_len && pending < wsize)
+                {
+                    put(st->in[st->in_pos++]);
+                    st->stored_len--;
+                }
+
+                if (st->stored_len > 0)
+                    return;
+
+                st->mode = st->last ? inflate_mode_done : inflate_mode_header;
+                continue;
+            }
+            else if (st->mode == inflate_mode_codes)
+            {
+                // Keep the room for the longest match that can't overwrite the unread octets.
+                if (pending + READYMAIL_DEFLATE_MAX_MATCH > wsize)
+                    return;
+
+                int symbol = decode(st->lencode);
+                if (symbol < 256)
+                {
+                    ret = symbol == -1 ? 0 : (symbol < 0 ? -1 : 1);
+                    if (ret == 1)
+                        put(symbol);
+                }
+                else if (symbol == 256)
+                    st->mode = st->last ? inflate_mode_done : inflate_mode_header;
+                else
+                {
+                    symbol -= 257;
+                    uint32_t len = 0, dist = 0;
+                    int dsym = -2;
+                    if (symbol >= 29)
+                        ret = -1;
+                    else if (!bits(rd_deflate_len_extra[symbol], len) || (dsym = decode(st->distcode)) == -1)
+                        ret = 0;
+                    else if (dsym < 0 || dsym >= 30)
+                        ret = -1;
+                    else if (!bits(rd_deflate_dist_extra[dsym], dist))
+                        ret = 0;
+
+                    if (ret == 1)
+                    {
+                        len += rd_deflate_len_base[symbol];
+                        dist += rd_deflate_dist_base[dsym];
+                        // The distance beyond the window or the data that was decoded.
+                        if (dist > wsize || dist > wpos)
+                            ret = -1;
+                        else
+                        {
+                            while (len--)
+                                put(win[(wpos - dist) & (wsize - 1)]);
+                        }
+                    }
+                }
+            }
+            else
+                return;
+
+            if (ret == 0)
+            {
+                st->in_pos = in_pos;
+                st->bitbuf = bitbuf;
+                st->bitcnt = bitcnt;
+                return;
+            }
+
+            if (ret < 0)
+                err = true;
+        }
+    }
+
+    void putBits(uint32_t value, uint8_t len)
+    {
+        out_bitbuf |= value << out_bitcnt;
+        out_bitcnt += len;
+        while (out_bitcnt >= 8)
+        {
+            out[out_len++] = out_bitbuf & 0xff;
+            out_bitbuf >>= 8;
+            out_bitcnt -= 8;
+        }
+    }
+
+    // Huffman codes are packed starting with the most significant bit.
+    void putCode(uint32_t code, uint8_t len)
+    {
+        uint32_t rev = 0;
+        for (uint8_t i = 0; i < len; i++)
+        {
+            rev = (rev << 1) | (code & 1);
+            code >>= 1;
+        }
+        putBits(rev, len);
+    }
+
+    void putSymbol(int symbol)
+    {
+        if (symbol < 144)
+            putCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            putCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            putCode(symbol - 256, 7);
+        else
+            putCode(0xc0 + symbol - 280, 8);
+    }
+
+    void putMatch(uint32_t len, uint32_t dist)
+    {
+        int i = 28;
+        while (rd_deflate_len_base[i] > len)
+            i--;
+        putSymbol(257 + i);
+        putBits(len - rd_deflate_len_base[i], rd_deflate_len_extra[i]);
+
+        i = 29;
+        while (rd_deflate_dist_base[i] > dist)
+            i--;
+        putCode(i, 5);
+        putBits(dist - rd_deflate_dist_base[i], rd_deflate_dist_extra[i]);
+    }
+
+    // Compress the buffered data as one block with the sync flush.
+    bool deflateBuffer()
+    {
+        if (dlen == 0)
+            return true;
+        bool ret = deflateChunk(dbuf, dlen);
+        dlen = 0;
+        return ret;
+    }
+
+    bool deflateChunk(const uint8_t *data, size_t len)
+    {
+        for (int i = 0; i < (1 << READYMAIL_DEFLATE_HASH_BITS); i++)
+            head[i] = -1;
+
+        out_len = 0;
+        out_bitbuf = 0;
+        out_bitcnt = 0;
+
+        // Non-final block with fixed Huffman codes.
+        putBits(0, 1);
+        putBits(1, 2);
+
+        size_t i = 0;
+        while (i < len)
+        {
+            uint32_t best = 0, dist = 0;
+            if (i + 2 < len)
+            {
+                int h = ((data[i] << 5) ^ (data[i + 1] << 2) ^ data[i + 2]) & ((1 << READYMAIL_DEFLATE_HASH_BITS) - 1);
+                int cand = head[h];
+                head[h] = i;
+                if (cand > -1 && i - cand <= wsize)
+                {
+                    uint32_t max = len - i > READYMAIL_DEFLATE_MAX_MATCH ? READYMAIL_DEFLATE_MAX_MATCH : len - i;
+                    while (best < max && data[cand + best] == data[i + best])
+                        best++;
+                    dist = i - cand;
+                }
+            }
+
+            if (best >= 3)
+            {
+                putMatch(best, dist);
+                i += best;
+            }
+            else
+                putSymbol(data[i++]);
+        }
+
+        // End of block and sync flush (empty stored block).
+        putSymbol(256);
+        putBits(0, 3);
+        if (out_bitcnt > 0)
+            putBits(0, 8 - out_bitcnt);
+        putBits(0, 16);
+        putBits(0xffff, 16);
+
+        bool ret = false;
+        if (out_len < len + 5)
+            ret = client->write(out, out_len) == out_len;
+        else
+        {
+            // Stored block (also the sync flush) when the data does not compress.
+            uint8_t hdr[5] = {0, (uint8_t)(len & 0xff), (uint8_t)(len >> 8), (uint8_t)(~len & 0xff), (uint8_t)((~len >> 8) & 0xff)};
+            ret = client->write(hdr, 5) == 5 && client->write(data, len) == len;
+        }
+        return ret;
+    }
+};
+
+#endif
+#endif
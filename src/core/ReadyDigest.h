@@ -0,0 +1,235 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READY_DIGEST_H
+#define READY_DIGEST_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_IMAP) || defined(ENABLE_SMTP)
+
+// The bits of digests to compute.
+enum readymail_digest_type
+{
+    readymail_digest_none = 0,
+    readymail_digest_md5 = 1 << 0,
+    readymail_digest_sha256 = 1 << 1
+};
+
+static const uint32_t rd_md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+static const uint8_t rd_md5_r[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+static const uint32_t rd_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/**
+ * The streaming MD5 (RFC 1321) and SHA-256 (FIPS 180-4) digests of the data that are processed in chunks.
+ *
+ * Both digests use 64-byte blocks, the block buffer is shared and each full block is processed by the selected digests.
+ */
+class ReadyDigest
+{
+public:
+    ReadyDigest() {}
+    ~ReadyDigest() {}
+
+    /** Start the digests computation.
+     *
+     * @param types The bits of readymail_digest_type to compute, readymail_digest_none to disable.
+     */
+    void begin(uint8_t types)
+    {
+        this->types = types;
+        total = 0;
+        const uint32_t md5_init[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+        const uint32_t sha256_init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(md5_state, md5_init, sizeof(md5_state));
+        memcpy(sha256_state, sha256_init, sizeof(sha256_state));
+    }
+
+    bool isActive() const { return types != readymail_digest_none; }
+
+    void update(const uint8_t *data, size_t len)
+    {
+        if (!isActive())
+            return;
+
+        size_t used = total % 64;
+        total += len;
+        while (len > 0)
+        {
+            size_t n = len < 64 - used ? len : 64 - used;
+            memcpy(block + used, data, n);
+            data += n;
+            len -= n;
+            used += n;
+            if (used == 64)
+            {
+                transform(block, types);
+                used = 0;
+            }
+        }
+    }
+
+    /** Finish the digests computation.
+     *
+     * @param md5 The lowercase hex string of MD5 digest or empty string if it was not computed.
+     * @param sha256 The lowercase hex string of SHA-256 digest or empty string if it was not computed.
+     */
+    void finish(String &md5, String &sha256)
+    {
+        md5.remove(0, md5.length());
+        sha256.remove(0, sha256.length());
+        if (!isActive())
+            return;
+
+        // The padding and message length (in bits) of both digests are the same except the byte order of length.
+        size_t used = total % 64;
+        uint64_t bits = total * 8;
+        uint8_t pad[128];
+        memcpy(pad, block, used);
+        pad[used] = 0x80;
+        size_t size = used < 56 ? 64 : 128;
+        memset(pad + used + 1, 0, size - used - 1);
+
+        if (types & readymail_digest_md5)
+        {
+            for (int i = 0; i < 8; i++)
+                pad[size - 8 + i] = (uint8_t)(bits >> (8 * i));
+            for (size_t i = 0; i < size; i += 64)
+                transform(pad + i, readymail_digest_md5);
+            toHex(md5, md5_state, 4, false);
+        }
+
+        if (types & readymail_digest_sha256)
+        {
+            for (int i = 0; i < 8; i++)
+                pad[size - 1 - i] = (uint8_t)(bits >> (8 * i));
+            for (size_t i = 0; i < size; i += 64)
+                transform(pad + i, readymail_digest_sha256);
+            toHex(sha256, sha256_state, 8, true);
+        }
+        types = readymail_digest_none;
+    }
+
+private:
+    uint8_t types = readymail_digest_none;
+    uint64_t total = 0;
+    uint32_t md5_state[4], sha256_state[8];
+    uint8_t block[64];
+
+    static uint32_t rotl(uint32_t x, uint8_t n) { return (x << n) | (x >> (32 - n)); }
+    static uint32_t rotr(uint32_t x, uint8_t n) { return (x >> n) | (x << (32 - n)); }
+
+    void transform(const uint8_t *p, uint8_t types)
+    {
+        if (types & readymail_digest_md5)
+            md5Transform(p);
+        if (types & readymail_digest_sha256)
+            sha256Transform(p);
+    }
+
+    void md5Transform(const uint8_t *p)
+    {
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++)
+            m[i] = (uint32_t)p[i * 4] | ((uint32_t)p[i * 4 + 1] << 8) | ((uint32_t)p[i * 4 + 2] << 16) | ((uint32_t)p[i * 4 + 3] << 24);
+
+        uint32_t a = md5_state[0], b = md5_state[1], c = md5_state[2], d = md5_state[3];
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t f;
+            int g;
+            if (i < 16)
+            {
+                f = (b & c) | (~b & d);
+                g = i;
+            }
+            else if (i < 32)
+            {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            }
+            else if (i < 48)
+            {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            }
+            else
+            {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            uint32_t t = d;
+            d = c;
+            c = b;
+            b = b + rotl(a + f + rd_md5_k[i] + m[g], rd_md5_r[(i / 16) * 4 + i % 4]);
+            a = t;
+        }
+        md5_state[0] += a;
+        md5_state[1] += b;
+        md5_state[2] += c;
+        md5_state[3] += d;
+    }
+
+    void sha256Transform(const uint8_t *p)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) | ((uint32_t)p[i * 4 + 2] << 8) | (uint32_t)p[i * 4 + 3];
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t s[8];
+        memcpy(s, sha256_state, sizeof(s));
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t t1 = s[7] + (rotr(s[4], 6) ^ rotr(s[4], 11) ^ rotr(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + rd_sha256_k[i] + w[i];
+            uint32_t t2 = (rotr(s[0], 2) ^ rotr(s[0], 13) ^ rotr(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+            memmove(s + 1, s, 7 * sizeof(uint32_t));
+            s[4] += t1;
+            s[0] = t1 + t2;
+        }
+
+        for (int i = 0; i < 8; i++)
+            sha256_state[i] += s[i];
+    }
+
+    void toHex(String &out, const uint32_t *state, int words, bool bigEndian)
+    {
+        static const char hex[] = "0123456789abcdef";
+        out.reserve(words * 8);
+        for (int i = 0; i < words * 4; i++)
+        {
+            uint8_t c = (uint8_t)(state[i / 4] >> (bigEndian ? 24 - 8 * (i % 4) : 8 * (i % 4)));
+            out += hex[c >> 4];
+            out += hex[c & 0x0f];
+        }
+    }
+};
+
+#endif
+#endif
@@ -0,0 +1,270 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The cooperative loop that steps the SMTPClient and IMAPClient instances fairly.
+#ifndef READY_LOOP_H
+#define READY_LOOP_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_IMAP) || defined(ENABLE_SMTP)
+
+#define DEFAULT_LOOP_CLIENT_BUDGET 20
+
+enum readymail_loop_client_type
+{
+    readymail_loop_client_smtp,
+    readymail_loop_client_imap
+};
+
+struct readymail_loop_client
+{
+    readymail_loop_client_type type = readymail_loop_client_smtp;
+    void *client = nullptr;
+    bool idling = false;
+    uint32_t budget = DEFAULT_LOOP_CLIENT_BUDGET, idle_timeout = 0;
+    // The time spent in this client and the number of steps that took longer than the budget.
+    unsigned long busy_ms = 0;
+    uint32_t overruns = 0;
+};
+
+typedef struct readymail_loop_client_status_t
+{
+    bool connected = false, authenticated = false, processing = false;
+    // The client was connected and authenticated and no operation is processing, a new operation can be started.
+    bool ready = false;
+    // The IMAP idle status was changed (IMAP only).
+    bool idleAvailable = false;
+    unsigned long busyMs = 0;
+    uint32_t overruns = 0;
+} ReadyMailClientStatus;
+
+/**
+ * The clients are stepped in round-robin order, each client is stepped until its operation is finished, no data
+ * is available or its time budget is used, so one slow transaction cannot block the others.
+ *
+ * The operations should be started in async mode (await parameter is false). When the await stepping is enabled,
+ * the other clients are also stepped while a blocking (await) operation of any client is waiting.
+ */
+class ReadyMailLoop
+{
+public:
+    ReadyMailLoop() {}
+    ~ReadyMailLoop() { setAwaitStepping(false); }
+
+#if defined(ENABLE_SMTP)
+    /** Add the SMTPClient to the loop.
+     *
+     * @param client The SMTPClient.
+     * @param budgetMs Optional. The time budget of each step in milliseconds.
+     * @return index of client.
+     */
+    int add(SMTPClient &client, uint32_t budgetMs = DEFAULT_LOOP_CLIENT_BUDGET)
+    {
+        readymail_loop_client c;
+        c.type = readymail_loop_client_smtp;
+        c.client = &client;
+        c.budget = budgetMs;
+        clients.push_back(c);
+        return clients.size() - 1;
+    }
+#endif
+
+#if defined(ENABLE_IMAP)
+    /** Add the IMAPClient to the loop.
+     *
+     * @param client The IMAPClient.
+     * @param idling Optional. The boolean option to idle the selected mailbox while no operation is processing.
+     * @param budgetMs Optional. The time budget of each step in milliseconds.
+     * @param idleTimeout Optional. The idling timeout in milliseconds, see IMAPClient::loop().
+     * @return index of client.
+     */
+    int add(IMAPClient &client, bool idling = false, uint32_t budgetMs = DEFAULT_LOOP_CLIENT_BUDGET, uint32_t idleTimeout = DEFAULT_IDLE_TIMEOUT)
+    {
+        readymail_loop_client c;
+        c.type = readymail_loop_client_imap;
+        c.client = &client;
+        c.idling = idling;
+        c.budget = budgetMs;
+        c.idle_timeout = idleTimeout;
+        clients.push_back(c);
+        return clients.size() - 1;
+    }
+#endif
+
+    /** Provides the number of clients.
+     *
+     * @return number of clients.
+     */
+    int count() { return clients.size(); }
+
+    /** Set the time budget of client.
+     *
+     * @param index The index of client.
+     * @param budgetMs The time budget of each step in milliseconds.
+     */
+    void setBudget(int index, uint32_t budgetMs)
+    {
+        if (isValid(index))
+            clients[index].budget = budgetMs;
+    }
+
+    /** Set the IMAP idling of client.
+     *
+     * @param index The index of client.
+     * @param idling The boolean option to idle the selected mailbox while no operation is processing.
+     */
+    void setIdling(int index, bool idling)
+    {
+        if (isValid(index))
+            clients[index].idling = idling;
+    }
+
+    /** Step the other clients while a blocking (await) operation of any client is waiting.
+     *
+     * @param enable The boolean option to enable the await stepping.
+     *
+     * Only one ReadyMailLoop can enable the await stepping. The callbacks of stepped clients are called from
+     * the blocking function of the waiting client, they should not call the blocking functions.
+     * The await stepping is bound to the task (thread) that enabled it, the blocking operations on other tasks
+     * e.g. the ReadyMailWorker task do not step the clients.
+     */
+    void setAwaitStepping(bool enable)
+    {
+        readymail_await_hook &hook = rd_await_hook();
+        if (enable)
+        {
+            hook.fn = awaitHook;
+            hook.arg = this;
+            hook.task = rd_task_id();
+        }
+        else if (hook.arg == this)
+        {
+            hook.fn = NULL;
+            hook.arg = nullptr;
+            hook.task = nullptr;
+        }
+    }
+
+    /** Perform the async processes of all clients.
+     * This should be called in the loop, each client is stepped once per call in round-robin order.
+     */
+    void loop() { step(nullptr); }
+
+    /** Provides the status of client.
+     *
+     * @param index The index of client.
+     * @return ReadyMailClientStatus struct data.
+     */
+    ReadyMailClientStatus status(int index)
+    {
+        ReadyMailClientStatus s;
+        if (!isValid(index))
+            return s;
+
+        readymail_loop_client &c = clients[index];
+#if defined(ENABLE_SMTP)
+        if (c.type == readymail_loop_client_smtp)
+        {
+            SMTPClient &client = *static_cast<SMTPClient *>(c.client);
+            s.connected = client.isConnected();
+            s.authenticated = client.isAuthenticated();
+            s.processing = client.isProcessing();
+        }
+#endif
+#if defined(ENABLE_IMAP)
+        if (c.type == readymail_loop_client_imap)
+        {
+            IMAPClient &client = *static_cast<IMAPClient *>(c.client);
+            s.connected = client.isConnected();
+            s.authenticated = client.isAuthenticated();
+            s.processing = client.isProcessing();
+            s.idleAvailable = client.available();
+        }
+#endif
+        s.ready = s.connected && s.authenticated && !s.processing;
+        s.busyMs = c.busy_ms;
+        s.overruns = c.overruns;
+        return s;
+    }
+
+    /** Provides the ready status of client.
+     *
+     * @param index The index of client.
+     * @return boolean status of client that was connected and authenticated and no operation is processing.
+     */
+    bool isReady(int index) { return status(index).ready; }
+
+private:
+    std::vector<readymail_loop_client> clients;
+    size_t rr = 0;
+    bool stepping = false;
+
+    bool isValid(int index) { return index > -1 && index < (int)clients.size(); }
+
+    static void awaitHook(void *arg, const void *client) { static_cast<ReadyMailLoop *>(arg)->step(client); }
+
+    // Step all clients except the client that is waiting in its blocking function.
+    void step(const void *skip)
+    {
+        if (stepping)
+            return;
+
+        stepping = true;
+        size_t n = clients.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            readymail_loop_client &c = clients[(rr + i) % n];
+            if (c.client != skip)
+                stepClient(c);
+        }
+        if (n > 0)
+            rr = (rr + 1) % n;
+        stepping = false;
+    }
+
+    void stepClient(readymail_loop_client &c)
+    {
+        unsigned long start = millis(), ms = 0;
+        do
+        {
+            unsigned long t = millis();
+            bool more = stepOnce(c);
+            if (millis() - t > c.budget)
+                c.overruns++;
+            if (!more)
+                break;
+            ms = millis() - start;
+        } while (ms < c.budget);
+        c.busy_ms += millis() - start;
+    }
+
+    // Step the client once, returns true when the client is processing and has the incoming data to step again.
+    bool stepOnce(readymail_loop_client &c)
+    {
+#if defined(ENABLE_SMTP)
+        if (c.type == readymail_loop_client_smtp)
+        {
+            SMTPClient &client = *static_cast<SMTPClient *>(c.client);
+            client.loop();
+            return client.isProcessing() && client.smtp_ctx.client && client.smtp_ctx.client->available() > 0;
+        }
+#endif
+#if defined(ENABLE_IMAP)
+        if (c.type == readymail_loop_client_imap)
+        {
+            IMAPClient &client = *static_cast<IMAPClient *>(c.client);
+            bool idling = c.idling && client.isConnected() && client.isAuthenticated() && client.imap_ctx.current_mailbox.length() > 0 && !client.isProcessing();
+            client.loop(idling, c.idle_timeout);
+            return client.isProcessing() && client.imap_ctx.client && client.imap_ctx.client->available() > 0;
+        }
+#endif
+        return false;
+    }
+};
+
+#endif
+#endif
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READY_QUEUE_H
+#define READY_QUEUE_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_WORKER)
+#include <atomic>
+#include <utility>
+
+/**
+ * The lock-free single-producer/single-consumer ring buffer queue.
+ *
+ * Only one task (thread) can push and only one other task can pop. The slot is owned by the producer until
+ * the head index was published and by the consumer until the tail index was published, no lock is required.
+ */
+template <typename T, size_t N>
+class ReadySPSCQueue
+{
+public:
+    ReadySPSCQueue() {}
+    ~ReadySPSCQueue() {}
+
+    /** Add the item to the queue (producer only).
+     *
+     * @param item The item to copy.
+     * @return boolean status of adding. It returns false when the queue is full.
+     */
+    bool push(const T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t next = (h + 1) % (N + 1);
+        if (next == tail.load(std::memory_order_acquire))
+            return false;
+        slots[h] = item;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /** Remove the oldest item from the queue (consumer only).
+     *
+     * @param item The item to move the oldest item to.
+     * @return boolean status of removing. It returns false when the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        item = std::move(slots[t]);
+        slots[t] = T();
+        tail.store((t + 1) % (N + 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+
+    size_t size() const
+    {
+        size_t h = head.load(std::memory_order_acquire), t = tail.load(std::memory_order_acquire);
+        return h >= t ? h - t : N + 1 - t + h;
+    }
+
+    size_t capacity() const { return N; }
+
+private:
+    // One slot is kept empty to distinguish the full queue from the empty queue.
+    T slots[N + 1];
+    std::atomic<size_t> head{0}, tail{0};
+};
+
+#endif
+#endif
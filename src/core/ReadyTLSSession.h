@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The per-host cache of TLS sessions for the session resumption (abbreviated handshake) on reconnect.
+#ifndef READY_TLS_SESSION_H
+#define READY_TLS_SESSION_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_IMAP) || defined(ENABLE_SMTP)
+
+#if !defined(READYMAIL_TLS_SESSION_CACHE_SIZE)
+#define READYMAIL_TLS_SESSION_CACHE_SIZE 4
+#endif
+
+#define DEFAULT_TLS_SESSION_LIFETIME 86400
+
+struct readymail_tls_session
+{
+    String host;
+    uint16_t port = 0;
+    // The session data that was exported by the SSL client e.g. the session ticket or the session ID and master secret.
+    std::vector<uint8_t> data;
+    unsigned long ts = 0;
+};
+
+/**
+ * The session data are opaque to ReadyMail, the TLSSessionCallback function exports the session data from the SSL client
+ * after the handshake (readymail_tls_session_mode_store) and imports it to the SSL client before the next handshake
+ * to the same host and port (readymail_tls_session_mode_apply), e.g. with the session API of BearSSL or mbedTLS.
+ *
+ * The session of host is removed when the handshake that the session was applied failed, the full handshake is
+ * performed on the next connection.
+ */
+class ReadyTLSSessionCache
+{
+public:
+    /** ReadyTLSSessionCache class constructor.
+     *
+     * @param sessionCallback The TLSSessionCallback callback function that exports and imports the session data of SSL client.
+     * @param lifetimeSec Optional. The lifetime of cached session in seconds. The default is 86400 seconds (one day).
+     */
+    explicit ReadyTLSSessionCache(ReadyMailCallbackNS::TLSSessionCallback sessionCallback = NULL, uint32_t lifetimeSec = DEFAULT_TLS_SESSION_LIFETIME)
+    {
+        this->cb = sessionCallback;
+        this->lifetime = lifetimeSec;
+    }
+    ~ReadyTLSSessionCache() {}
+
+    /** Set the TLSSessionCallback callback function.
+     *
+     * @param sessionCallback The TLSSessionCallback callback function that exports and imports the session data of SSL client.
+     */
+    void setCallback(ReadyMailCallbackNS::TLSSessionCallback sessionCallback) { cb = sessionCallback; }
+
+    /** Set the lifetime of cached session.
+     *
+     * @param lifetimeSec The lifetime of cached session in seconds, 0 for no expiry.
+     * It should not be longer than the session lifetime of server e.g. the lifetime hint of session ticket.
+     */
+    void setLifetime(uint32_t lifetimeSec) { lifetime = lifetimeSec; }
+
+    /** Remove the cached session of host.
+     *
+     * @param host The server host name.
+     * @param port The server port.
+     */
+    void remove(const String &host, uint16_t port)
+    {
+        int i = find(host, port);
+        if (i > -1)
+            sessions.erase(sessions.begin() + i);
+    }
+
+    /** Remove all cached sessions.
+     */
+    void clear() { sessions.clear(); }
+
+    /** Provides the number of cached sessions.
+     *
+     * @return number of cached sessions.
+     */
+    size_t size() { return sessions.size(); }
+
+    // Internal used functions.
+    // Import the cached session to the SSL client before the handshake, the empty session data are provided when
+    // no session was cached for the host so that the session of other host is not used.
+    // Returns true when the cached session was imported.
+    bool apply(Client &client, const String &host, uint16_t port)
+    {
+        if (!cb)
+            return false;
+
+        int i = find(host, port);
+        if (i > -1 && lifetime > 0 && millis() - sessions[i].ts > lifetime * 1000UL)
+        {
+            sessions.erase(sessions.begin() + i);
+            i = -1;
+        }
+
+        std::vector<uint8_t> data;
+        if (i > -1)
+            data = sessions[i].data;
+        return cb(client, data, readymail_tls_session_mode_apply) && i > -1;
+    }
+
+    // Internal used functions.
+    // Export the session from the SSL client after the handshake, the most recent session is the first.
+    void store(Client &client, const String &host, uint16_t port)
+    {
+        if (!cb)
+            return;
+
+        readymail_tls_session session;
+        if (!cb(client, session.data, readymail_tls_session_mode_store) || session.data.size() == 0)
+            return;
+
+        remove(host, port);
+        session.host = host;
+        session.port = port;
+        session.ts = millis();
+        sessions.insert(sessions.begin(), session);
+        if (sessions.size() > READYMAIL_TLS_SESSION_CACHE_SIZE)
+            sessions.pop_back();
+    }
+
+private:
+    std::vector<readymail_tls_session> sessions;
+    ReadyMailCallbackNS::TLSSessionCallback cb = NULL;
+    uint32_t lifetime = DEFAULT_TLS_SESSION_LIFETIME;
+
+    int find(const String &host, uint16_t port)
+    {
+        for (size_t i = 0; i < sessions.size(); i++)
+        {
+            if (sessions[i].port == port && sessions[i].host.equalsIgnoreCase(host))
+                return i;
+        }
+        return -1;
+    }
+};
+
+// The TLS session of connection that is shared by SMTPClient and IMAPClient, the session is applied before the handshake,
+// stored after the handshake was done and removed when the handshake that resumed the session failed.
+class ReadyTLSSessionState
+{
+public:
+    ReadyTLSSessionState() {}
+    ~ReadyTLSSessionState() {}
+
+    // Import the cached session of host to the SSL client, the cache is nullptr for the plain connection.
+    // Returns true when the cached session was imported.
+    bool apply(ReadyTLSSessionCache *cache, Client *client, const String &host, uint16_t port)
+    {
+        this->cache = client ? cache : nullptr;
+        this->client = client;
+        this->host = host;
+        this->port = port;
+        applied = this->cache && this->cache->apply(*client, host, port);
+        return applied;
+    }
+
+    // Export the session from the SSL client after the handshake.
+    void store()
+    {
+        if (cache)
+            cache->store(*client, host, port);
+    }
+
+    // The handshake failed, the cached session that was applied is removed.
+    void fail()
+    {
+        if (cache && applied)
+            cache->remove(host, port);
+        reset();
+    }
+
+    void reset()
+    {
+        cache = nullptr;
+        client = nullptr;
+        applied = false;
+    }
+
+private:
+    ReadyTLSSessionCache *cache = nullptr;
+    Client *client = nullptr;
+    String host;
+    uint16_t port = 0;
+    bool applied = false;
+};
+
+#endif
+#endif
@@ -0,0 +1,427 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The worker that runs the SMTPClient and IMAPClient operations on its own task (thread).
+#ifndef READY_WORKER_H
+#define READY_WORKER_H
+
+#include <Arduino.h>
+
+#if defined(ENABLE_WORKER) && (defined(ENABLE_IMAP) || defined(ENABLE_SMTP))
+#include "ReadyQueue.h"
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#include <chrono>
+#endif
+
+#if !defined(READYMAIL_WORKER_REQUEST_QUEUE_SIZE)
+#define READYMAIL_WORKER_REQUEST_QUEUE_SIZE 8
+#endif
+
+#if !defined(READYMAIL_WORKER_EVENT_QUEUE_SIZE)
+#define READYMAIL_WORKER_EVENT_QUEUE_SIZE 16
+#endif
+
+#if !defined(READYMAIL_WORKER_STACK_SIZE)
+#define READYMAIL_WORKER_STACK_SIZE 8192
+#endif
+
+// The function that runs on the worker task and returns the status of its operation.
+typedef bool (*ReadyMailWorkerJob)(void *arg);
+
+enum readymail_worker_request_type
+{
+    readymail_worker_request_none,
+    readymail_worker_request_job,
+    readymail_worker_request_send,
+    readymail_worker_request_fetch,
+    readymail_worker_request_fetch_uid,
+    readymail_worker_request_search
+};
+
+enum readymail_worker_event_type
+{
+    readymail_worker_event_undefined,
+    // The request was finished, see success and errorCode.
+    readymail_worker_event_result,
+    // The message headers of fetch or search request.
+    readymail_worker_event_envelope,
+    // The chunk of decoded body part data of fetch request.
+    readymail_worker_event_body
+};
+
+struct readymail_worker_request
+{
+    readymail_worker_request_type type = readymail_worker_request_none;
+    uint32_t id = 0, number = 0, limit = 0;
+    bool recent_sort = true;
+    String criteria;
+    ReadyMailWorkerJob job = NULL;
+    void *arg = nullptr;
+#if defined(ENABLE_SMTP)
+    SMTPMessage *msg = nullptr;
+#endif
+};
+
+typedef struct readymail_worker_event_t
+{
+    readymail_worker_event_type type = readymail_worker_event_undefined;
+    // The id of request that this event belongs to.
+    uint32_t id = 0;
+    bool success = false;
+    int errorCode = 0;
+    // The message number (or UID) and UID of envelope and body events, and the number of messages found in search.
+    uint32_t msgNum = 0, uid = 0;
+    int found = 0;
+    std::vector<std::pair<String, String>> headers;
+    // The body part info and its decoded data chunk.
+    String filename, mime;
+    std::vector<uint8_t> data;
+    uint32_t index = 0;
+    bool isComplete = false;
+} ReadyMailWorkerEvent;
+
+/**
+ * The requests are added by the application task and are run one by one with the blocking functions of SMTPClient
+ * and IMAPClient on the worker task. The data callbacks and results are copied to the events that are read by the
+ * application task, so the application is not blocked by the network.
+ *
+ * Both queues are lock-free single-producer/single-consumer queues, all functions except the job functions should be
+ * called from the same application task. The clients should not be used by the application task while the worker is running.
+ */
+class ReadyMailWorker
+{
+public:
+    ReadyMailWorker() {}
+    ~ReadyMailWorker() { end(); }
+
+#if defined(ENABLE_SMTP)
+    /** Set the SMTPClient that runs the send requests.
+     *
+     * @param client The SMTPClient that was connected and authenticated or will be by the job requests.
+     */
+    void setClient(SMTPClient &client) { smtp = &client; }
+#endif
+
+#if defined(ENABLE_IMAP)
+    /** Set the IMAPClient that runs the fetch and search requests.
+     *
+     * @param client The IMAPClient that the mailbox was selected or will be by the job requests.
+     */
+    void setClient(IMAPClient &client) { imap = &client; }
+#endif
+
+    /** Start the worker task.
+     *
+     * @param stackSize Optional. The stack size of worker task in bytes (ESP32 only).
+     * @param priority Optional. The priority of worker task (ESP32 only).
+     * @param coreId Optional. The core that the worker task is pinned to, -1 for no affinity (ESP32 only).
+     * @return boolean status of starting.
+     */
+    bool begin(uint32_t stackSize = READYMAIL_WORKER_STACK_SIZE, uint8_t priority = 1, int coreId = -1)
+    {
+        if (running.load())
+            return true;
+
+        running.store(true);
+#if defined(ESP32)
+        alive.store(true);
+        BaseType_t ret = coreId < 0 ? xTaskCreate(taskFn, "ReadyMailWorker", stackSize, this, priority, &task)
+                                    : xTaskCreatePinnedToCore(taskFn, "ReadyMailWorker", stackSize, this, priority, &task, coreId);
+        if (ret != pdPASS)
+        {
+            running.store(false);
+            alive.store(false);
+            return false;
+        }
+#else
+        (void)stackSize;
+        (void)priority;
+        (void)coreId;
+        thread = std::thread(taskFn, this);
+#endif
+        return true;
+    }
+
+    /** Stop the worker task.
+     * The current request is finished and the requests in the queue are discarded.
+     */
+    void end()
+    {
+        if (!running.load())
+            return;
+
+        running.store(false);
+#if defined(ESP32)
+        xTaskNotifyGive(task);
+        while (alive.load())
+            delay(1);
+        task = NULL;
+#else
+        if (thread.joinable())
+            thread.join();
+#endif
+        readymail_worker_request req;
+        while (requests.pop(req))
+        {
+        }
+    }
+
+    bool isRunning() { return running.load(); }
+
+#if defined(ENABLE_SMTP)
+    /** Send the Email message on the worker task.
+     *
+     * @param message The SMTPMessage class object that should be valid and not be changed until the result event of request.
+     * @return id of request or 0 if the request queue is full.
+     */
+    uint32_t send(SMTPMessage &message)
+    {
+        readymail_worker_request req;
+        req.type = readymail_worker_request_send;
+        req.msg = &message;
+        return post(req);
+    }
+#endif
+
+#if defined(ENABLE_IMAP)
+    /** Fetch the message in the selected mailbox on the worker task.
+     * The headers and the decoded body part data are provided in the envelope and body events.
+     *
+     * @param number The message number or UID when uidFetch is true.
+     * @param uidFetch Optional. The boolean option to fetch the message by UID.
+     * @param bodySizeLimit Optional. The maximum size of body part content that can be streamed in bytes.
+     * @return id of request or 0 if the request queue is full.
+     */
+    uint32_t fetch(uint32_t number, bool uidFetch = false, uint32_t bodySizeLimit = 5 * 1024 * 1024)
+    {
+        readymail_worker_request req;
+        req.type = uidFetch ? readymail_worker_request_fetch_uid : readymail_worker_request_fetch;
+        req.number = number;
+        req.limit = bodySizeLimit;
+        return post(req);
+    }
+
+    /** Search the selected mailbox on the worker task.
+     * The headers of found messages are provided in the envelope events.
+     *
+     * @param criteria The search criteria, see IMAPClient::search().
+     * @param searchLimit The maximum number of message (number or UID) that can store in the message list.
+     * @param recentSort The boolean option for recent sort order.
+     * @return id of request or 0 if the request queue is full.
+     */
+    uint32_t search(const String &criteria, uint32_t searchLimit, bool recentSort)
+    {
+        readymail_worker_request req;
+        req.type = readymail_worker_request_search;
+        req.criteria = criteria;
+        req.limit = searchLimit;
+        req.recent_sort = recentSort;
+        return post(req);
+    }
+#endif
+
+    /** Run the function on the worker task e.g. for connecting, authenticating and selecting the mailbox.
+     *
+     * @param job The ReadyMailWorkerJob function that returns the status of its operation.
+     * @param arg Optional. The argument that is passed to the function.
+     * @return id of request or 0 if the request queue is full.
+     */
+    uint32_t run(ReadyMailWorkerJob job, void *arg = nullptr)
+    {
+        readymail_worker_request req;
+        req.type = readymail_worker_request_job;
+        req.job = job;
+        req.arg = arg;
+        return post(req);
+    }
+
+    /** Read the oldest event from the worker.
+     *
+     * @param event The ReadyMailWorkerEvent to store the event.
+     * @return boolean status of event reading. It returns false when no event is available.
+     *
+     * The worker waits while the event queue is full, the events should be read continuously.
+     */
+    bool readEvent(ReadyMailWorkerEvent &event) { return events.pop(event); }
+
+private:
+    ReadySPSCQueue<readymail_worker_request, READYMAIL_WORKER_REQUEST_QUEUE_SIZE> requests;
+    ReadySPSCQueue<ReadyMailWorkerEvent, READYMAIL_WORKER_EVENT_QUEUE_SIZE> events;
+    std::atomic<bool> running{false};
+    uint32_t last_id = 0;
+    // The id of request that is running on the worker task.
+    uint32_t cur_id = 0;
+#if defined(ESP32)
+    TaskHandle_t task = NULL;
+    std::atomic<bool> alive{false};
+#else
+    std::thread thread;
+#endif
+#if defined(ENABLE_SMTP)
+    SMTPClient *smtp = nullptr;
+#endif
+#if defined(ENABLE_IMAP)
+    IMAPClient *imap = nullptr;
+#endif
+
+    // The worker that runs on the current task, for relaying the data callbacks.
+    static ReadyMailWorker *&current()
+    {
+        static thread_local ReadyMailWorker *worker = nullptr;
+        return worker;
+    }
+
+    uint32_t post(readymail_worker_request &req)
+    {
+        if (!running.load())
+            return 0;
+        if (++last_id == 0)
+            last_id = 1;
+        req.id = last_id;
+        if (!requests.push(req))
+            return 0;
+#if defined(ESP32)
+        xTaskNotifyGive(task);
+#endif
+        return req.id;
+    }
+
+    void wait(uint32_t ms)
+    {
+#if defined(ESP32)
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+#endif
+    }
+
+    // Wait for the free slot in event queue, the event is dropped when the worker was stopped.
+    void postEvent(const ReadyMailWorkerEvent &event)
+    {
+        while (!events.push(event) && running.load())
+            wait(1);
+    }
+
+    static void taskFn(void *arg)
+    {
+        ReadyMailWorker *self = static_cast<ReadyMailWorker *>(arg);
+        current() = self;
+        self->loop();
+        current() = nullptr;
+#if defined(ESP32)
+        self->alive.store(false);
+        vTaskDelete(NULL);
+#endif
+    }
+
+    void loop()
+    {
+        while (running.load())
+        {
+            readymail_worker_request req;
+            if (requests.pop(req))
+                process(req);
+            else
+                wait(10);
+        }
+    }
+
+    void process(readymail_worker_request &req)
+    {
+        ReadyMailWorkerEvent event;
+        event.type = readymail_worker_event_result;
+        event.id = req.id;
+        cur_id = req.id;
+
+        switch (req.type)
+        {
+        case readymail_worker_request_job:
+            event.success = req.job && req.job(req.arg);
+            break;
+
+#if defined(ENABLE_SMTP)
+        case readymail_worker_request_send:
+            if (smtp && req.msg)
+            {
+                event.success = smtp->send(*req.msg);
+                event.errorCode = event.success ? 0 : smtp->status().errorCode;
+            }
+            break;
+#endif
+
+#if defined(ENABLE_IMAP)
+        case readymail_worker_request_fetch:
+        case readymail_worker_request_fetch_uid:
+        case readymail_worker_request_search:
+            if (imap)
+            {
+                if (req.type == readymail_worker_request_search)
+                    event.success = imap->search(req.criteria, req.limit, req.recent_sort, relayData);
+                else if (req.type == readymail_worker_request_fetch_uid)
+                    event.success = imap->fetchUID(req.number, relayData, NULL, true, req.limit);
+                else
+                    event.success = imap->fetch(req.number, relayData, NULL, true, req.limit);
+                event.errorCode = event.success ? 0 : imap->status().errorCode;
+            }
+            break;
+#endif
+
+        default:
+            break;
+        }
+        cur_id = 0;
+        postEvent(event);
+    }
+
+#if defined(ENABLE_IMAP)
+    // Copy the callback data to the event, the data are valid only until the callback returns.
+    static void relayData(IMAPCallbackData &data)
+    {
+        ReadyMailWorker *self = current();
+        if (!self)
+            return;
+
+        ReadyMailWorkerEvent event;
+        event.id = self->cur_id;
+        event.msgNum = data.messageAvailable() > 0 ? data.messageNum() : self->imap->currentMessage();
+        event.uid = data.messageUID();
+        event.found = data.messageFound();
+
+        if (data.event() == imap_data_event_search || data.event() == imap_data_event_fetch_envelope)
+        {
+            event.type = readymail_worker_event_envelope;
+            event.headers.reserve(data.headerCount());
+            for (size_t i = 0; i < data.headerCount(); i++)
+                event.headers.push_back(data.getHeader(i));
+        }
+        else if (data.event() == imap_data_event_fetch_body)
+        {
+            imap_file_chunk chunk = data.fileChunk();
+            if (chunk.size == 0 && !chunk.isComplete)
+                return;
+            event.type = readymail_worker_event_body;
+            imap_file_info info = data.fileInfo();
+            event.filename = info.filename;
+            event.mime = info.mime;
+            event.index = chunk.index;
+            event.isComplete = chunk.isComplete;
+            if (chunk.size > 0)
+                event.data.assign(chunk.data, chunk.data + chunk.size);
+        }
+        else
+            return;
+
+        self->postEvent(event);
+    }
+#endif
+};
+
+#endif
+#endif
@@ -8,9 +8,13 @@
 #define IMAP_COMMON_H
 #if defined(ENABLE_IMAP)
 #include <Arduino.h>
+#include "./core/ReadyCharset.h"
 #if defined(ENABLE_IMAP_APPEND)
 #include "smtp/SMTPClient.h"
 #endif
+#if defined(ENABLE_IMAP_COMPRESS)
+#include "./core/ReadyDeflate.h"
+#endif
 
 #define IMAP_ERROR_RESPONSE -100
 #define IMAP_ERROR_NO_MAILBOX -101
@@ -23,9 +27,27 @@
 #define IMAP_ERROR_NO_CALLBACK -108
 #define IMAP_ERROR_COMMAND_NOT_ALLOW -109
 #define IMAP_ERROR_FETCH_MESSAGE -110
+#define IMAP_ERROR_INVALID_RESUME_POINT -111
+#define IMAP_ERROR_COMPRESSION -112
+#define IMAP_ERROR_SORT_NOT_SUPPORTED -113
+#define IMAP_ERROR_THREAD_NOT_SUPPORTED -114
+#define IMAP_ERROR_PART_SINK -115
 
 #define DEFAULT_IDLE_TIMEOUT 8 * 60 * 1000
 
+// The maximum number of STATUS commands that are sent at once when LIST-STATUS is not supported.
+#if !defined(IMAP_STATUS_PIPELINE_SIZE)
+#define IMAP_STATUS_PIPELINE_SIZE 8
+#endif
+
+// The bits of all imap_envelope_enum fields for IMAPClient::setEnvelopeFields().
+#define IMAP_ENVELOPE_ALL_FIELDS ((1 << imap_envelpe_max_type) - 1)
+
+// The maximum number of IDLE events that can be kept in the event queue.
+#if !defined(IMAP_IDLE_EVENT_QUEUE_SIZE)
+#define IMAP_IDLE_EVENT_QUEUE_SIZE 16
+#endif
+
 using namespace ReadyMailCallbackNS;
 
 namespace ReadyMailIMAP
@@ -75,7 +97,14 @@ namespace ReadyMailIMAP
         imap_state_unselect,
         imap_state_copy,
         imap_state_send_command,
-        imap_state_stop
+        imap_state_stop,
+        imap_state_compress,
+        imap_state_enable,
+        imap_state_sync,
+        imap_state_uid_map,
+        imap_state_status,
+        imap_state_sort,
+        imap_state_thread
     };
 
     enum imap_mailbox_mode
@@ -120,6 +149,17 @@ namespace ReadyMailIMAP
         imap_read_cap_children,
         // rfc7162 (rfc4551 obsoleted)
         imap_read_cap_condstore,
+        imap_read_cap_qresync,
+        // rfc4978
+        imap_read_cap_compress_deflate,
+        // rfc4731
+        imap_read_cap_esearch,
+        // rfc5819
+        imap_read_cap_list_status,
+        // rfc5256
+        imap_read_cap_sort,
+        imap_read_cap_thread_references,
+        imap_read_cap_thread_orderedsubject,
         imap_read_cap_auto_caps,
         imap_read_cap_max_type
     };
@@ -147,6 +187,7 @@ namespace ReadyMailIMAP
         server_status_bad
     };
 
+    // Deprecated, the charsets of text part are the rd_charset_id of ReadyCharset.h.
     enum imap_char_encoding_types
     {
         imap_char_encoding_utf8,
@@ -157,6 +198,7 @@ namespace ReadyMailIMAP
         imap_char_encoding_max_type
     };
 
+    // Deprecated, the charsets of text part are the rd_charset_id of ReadyCharset.h.
     enum imap_char_encoding_scheme
     {
         imap_char_encoding_scheme_default = -1,
@@ -254,6 +296,81 @@ namespace ReadyMailIMAP
         imap_data_event_fetch_body
     };
 
+    enum imap_sync_event
+    {
+        imap_sync_event_undefined,
+        // The flags of message were changed or the new message was added.
+        imap_sync_event_changed,
+        // The messages were expunged (QRESYNC only).
+        imap_sync_event_vanished,
+        // The UIDVALIDITY was changed, the stored mailbox state is no longer valid.
+        imap_sync_event_invalidated
+    };
+
+    enum imap_idle_event_type
+    {
+        imap_idle_event_undefined,
+        // The messages were added, the mailbox message count is msgNum + count - 1.
+        imap_idle_event_exists,
+        // The messages were removed, the message numbers are of the mailbox before removal.
+        imap_idle_event_expunge,
+        // The flags of messages were changed.
+        imap_idle_event_fetch,
+        // The messages were removed (QRESYNC was enabled), the msgNum is the first UID of removed messages.
+        imap_idle_event_vanished
+    };
+
+    enum imap_message_flag
+    {
+        imap_message_flag_seen = 1 << 0,
+        imap_message_flag_answered = 1 << 1,
+        imap_message_flag_flagged = 1 << 2,
+        imap_message_flag_deleted = 1 << 3,
+        imap_message_flag_draft = 1 << 4,
+        imap_message_flag_recent = 1 << 5,
+        // Any other flag or keyword was assigned.
+        imap_message_flag_keyword = 1 << 6
+    };
+
+    enum imap_mailbox_attribute
+    {
+        imap_mailbox_attr_noselect = 1 << 0,
+        imap_mailbox_attr_noinferiors = 1 << 1,
+        imap_mailbox_attr_has_children = 1 << 2,
+        imap_mailbox_attr_has_no_children = 1 << 3,
+        imap_mailbox_attr_marked = 1 << 4,
+        imap_mailbox_attr_unmarked = 1 << 5,
+        imap_mailbox_attr_nonexistent = 1 << 6,
+        imap_mailbox_attr_subscribed = 1 << 7,
+        imap_mailbox_attr_remote = 1 << 8,
+        // rfc6154
+        imap_mailbox_attr_all = 1 << 9,
+        imap_mailbox_attr_archive = 1 << 10,
+        imap_mailbox_attr_drafts = 1 << 11,
+        imap_mailbox_attr_flagged = 1 << 12,
+        imap_mailbox_attr_junk = 1 << 13,
+        imap_mailbox_attr_sent = 1 << 14,
+        imap_mailbox_attr_trash = 1 << 15
+    };
+
+    // rfc5256
+    enum imap_sort_key
+    {
+        imap_sort_key_arrival,
+        imap_sort_key_cc,
+        imap_sort_key_date,
+        imap_sort_key_from,
+        imap_sort_key_size,
+        imap_sort_key_subject,
+        imap_sort_key_to
+    };
+
+    enum imap_thread_algorithm
+    {
+        imap_thread_references,
+        imap_thread_orderedsubject
+    };
+
     __attribute__((used)) struct
     {
         bool operator()(uint32_t a, uint32_t b) const { return a > b; }
@@ -283,7 +400,8 @@ namespace ReadyMailIMAP
     // Portable across all platforms — no PROGMEM, no dependence on ESP8266 non32xfer handler, no alignment concerns.
     const struct imap_envelope_t imap_envelopes[imap_envelpe_max_type] = {{"Date"}, {"Subject"}, {"From"}, {"Sender"}, {"Reply-To"}, {"To"}, {"Cc"}, {"Bcc"}, {"In-Reply-To"}, {"Message-ID"}};
     const struct imap_auth_cap_t imap_auth_cap_token[imap_auth_cap_max_type] = {{"AUTH=PLAIN"}, {"AUTH=XOAUTH2"}, {"AUTH=CRAM-MD5"}, {"AUTH=DIGEST-MD5"}, {"AUTH=LOGIN"}, {"STARTTLS"}, {"SASL-IR"}};
-    const struct imap_read_cap_t imap_read_cap_token[imap_read_cap_max_type] = {{"IMAP4"}, {"IMAP4rev1"}, {"IDLE"}, {"LITERAL+"}, {"LITERAL-"}, {"MULTIAPPEND"}, {"UIDPLUS"}, {"ACL"}, {"BINARY"}, {"LOGINDISABLED"}, {"MOVE"}, {"QUOTA"}, {"NAMESPACE"}, {"ENABLE"}, {"ID"}, {"UNSELECT"}, {"CHILDREN"}, {"CONDSTORE"}, {"" /* Auto cap */}};
+    const struct imap_read_cap_t imap_read_cap_token[imap_read_cap_max_type] = {{"IMAP4"}, {"IMAP4rev1"}, {"IDLE"}, {"LITERAL+"}, {"LITERAL-"}, {"MULTIAPPEND"}, {"UIDPLUS"}, {"ACL"}, {"BINARY"}, {"LOGINDISABLED"}, {"MOVE"}, {"QUOTA"}, {"NAMESPACE"}, {"ENABLE"}, {"ID"}, {"UNSELECT"}, {"CHILDREN"}, {"CONDSTORE"}, {"QRESYNC"}, {"COMPRESS=DEFLATE"}, {"ESEARCH"}, {"LIST-STATUS"}, {"SORT"}, {"THREAD=REFERENCES"}, {"THREAD=ORDEREDSUBJECT"}, {"" /* Auto cap */}};
+    // Deprecated, use rd_charset_find() of ReadyCharset.h.
     const struct imap_char_encoding_t imap_char_encodings[imap_char_encoding_max_type] = {{"utf-8"}, {"iso-8859-1"}, {"iso-8859-11"}, {"tis-620"}, {"windows-874"}};
 
     struct imap_state_info
@@ -313,12 +431,90 @@ namespace ReadyMailIMAP
         imap_function_return_code ret = function_return_undefined;
     };
 
+    typedef struct imap_sync_data_t
+    {
+        imap_sync_event event = imap_sync_event_undefined;
+        // The message number and UID of changed message.
+        uint32_t number = 0, uid = 0;
+        // The modification sequence of changed message.
+        uint64_t modseq = 0;
+        // The flags of changed message e.g. "\Seen \Flagged" or the UID set of vanished messages e.g. "41,43:116".
+        String flags, uids;
+    } IMAPSyncData;
+
+    typedef struct imap_idle_event_t
+    {
+        imap_idle_event_type type = imap_idle_event_undefined;
+        // The first message number (or UID) and the number of messages in range.
+        uint32_t msgNum = 0, count = 0;
+        // The UID of the first message in range from the UID map (IMAPClient::updateUIDMap), 0 if it is unknown.
+        uint32_t uid = 0;
+        // The imap_message_flag bits of changed messages.
+        uint8_t flags = 0;
+    } IMAPIdleEvent;
+
+    // The fixed-capacity ring buffer of IDLE events.
+    struct imap_idle_queue
+    {
+        static_assert(IMAP_IDLE_EVENT_QUEUE_SIZE > 0, "IMAP_IDLE_EVENT_QUEUE_SIZE must be greater than 0");
+        IMAPIdleEvent events[IMAP_IDLE_EVENT_QUEUE_SIZE];
+        size_t head = 0, count = 0;
+        // The number of oldest events that were overwritten when the queue is full.
+        uint32_t dropped = 0;
+        bool coalesce = true;
+    };
+
+    // The hierarchy and attributes of mailbox in IMAPClient::mailboxes list, the -1 index is used for no mailbox.
+    typedef struct imap_mailbox_node_t
+    {
+        int parent = -1, firstChild = -1, nextSibling = -1;
+        // The imap_mailbox_attribute bits.
+        uint16_t attributes = 0;
+    } IMAPMailboxNode;
+
+    // The SORT criterion, the criteria are applied in order.
+    typedef struct imap_sort_criterion_t
+    {
+        imap_sort_key key = imap_sort_key_date;
+        bool reverse = false;
+    } IMAPSortCriterion;
+
+    // The message in THREAD response, the msgNum is the message number or UID and it is 0 for the missing parent message.
+    typedef struct imap_thread_node_t
+    {
+        uint32_t msgNum = 0;
+        int parent = -1, firstChild = -1, nextSibling = -1;
+    } IMAPThreadNode;
+
+    // The mailbox summary from LIST-STATUS or STATUS response.
+    typedef struct imap_mailbox_status_t
+    {
+        String name;
+        uint32_t messages = 0, unseen = 0, uidNext = 0;
+        // False when the server rejected the STATUS command of mailbox e.g. the mailbox that does not exist.
+        bool available = true;
+    } IMAPMailboxStatus;
+
+    // The mailbox state that is stored for the incremental resynchronization.
+    struct imap_sync_point
+    {
+        uint32_t uidValidity = 0;
+        uint64_t highestModseq = 0;
+        // Optional. The UID set of the messages that are known to the client e.g. "1:200" for QRESYNC VANISHED report.
+        String knownUIDs;
+    };
+
     typedef void (*IMAPResponseCallback)(IMAPStatus status);
 
+    typedef void (*IMAPSyncCallback)(IMAPSyncData data);
+
     typedef void (*IMAPCustomComandCallback)(IMAPCommandResponse response);
 
     typedef void (*IMAPTextDecodingCallback)(const String &charset, const uint8_t *in, int inSize, uint8_t *out, int &outSize);
 
+    // The body part sink write function, returns the number of bytes accepted, 0 when the sink is not ready or negative value for error.
+    typedef int (*IMAPPartWriteCallback)(const uint8_t *data, size_t size);
+
     struct imap_timeout
     {
         unsigned long con = 1000 * 3, send = 1000 * 30, read = 1000 * 120;
@@ -333,8 +529,16 @@ namespace ReadyMailIMAP
         uint32_t fetch_number;
         int32_t modsequence = -1;
         uint32_t part_size_limit = 1024 * 1024;
+        uint32_t fetch_window = 0; // the maximum octets of body part to request per FETCH command, 0 for whole part
         bool uid_search = false, uid_fetch = false, searching = false, processing = false, idling = false, multiline = false, await = false;
-        bool use_auto_client = false;
+        bool use_auto_client = false, syncing = false, list_status = false;
+        // The imap_envelope_enum bits of envelope fields to decode and store.
+        uint16_t envelope_fields = IMAP_ENVELOPE_ALL_FIELDS;
+        bool multipart_fetch = false, binary_fetch = false, resume = false;
+        bool compress = false, sink_error = false;
+        uint8_t digest_types = readymail_digest_none;
+        uint8_t compress_window_bits = 15;
+        readymail_wait_strategy wait;
     };
 
     // body part field item
@@ -354,10 +558,24 @@ namespace ReadyMailIMAP
         int depth = 0, field_index = 0;
     };
 
+    struct imap_resume_point
+    {
+        // The UIDVALIDITY of mailbox and UID of message.
+        uint32_t uidValidity = 0, uid = 0;
+        // The number of (encoded) octets of body part that were already received and the number of decoded bytes that were already stored.
+        uint32_t offset = 0, index = 0;
+        // The body part section e.g. 1, 1.2.
+        String section;
+        // The body part was fetched with BINARY (the offset is the number of decoded octets).
+        bool binary = false;
+    };
+
     struct imap_file_info
     {
         String filename, mime, charset, transferEncoding;
         uint32_t fileSize = 0;
+        // The lowercase hex digests of decoded content that are available when the body part is complete, see IMAPClient::setDigest().
+        String md5, sha256;
     };
 
     struct imap_file_chunk
@@ -388,31 +606,72 @@ namespace ReadyMailIMAP
         String downloadFolder;
 #endif
         IMAPTextDecodingCallback textEncCb = NULL;
+        // The sink that the decoded data are written to.
+        Print *sink = nullptr;
+        IMAPPartWriteCallback sinkCb = NULL;
 
     private:
         friend class IMAPParser;
+        friend class IMAPCallbackData;
+        friend class IMAPCache;
         String section, filepath;
         uint32_t octet_count = 0, total_read = 0, decoded_len = 0 /* The sum of the decoded octet */;
+        // The received octets for ranged fetch and the last octet offset and decoded index that can be resumed.
+        uint32_t offset = 0, checkpoint = 0, checkpoint_index = 0;
+        // The checkpoint that is committed when its decoded data were written to file.
+        uint32_t pending_checkpoint = 0, pending_checkpoint_index = 0;
         imap_transfer_encoding_scheme transfer_encoding = imap_transfer_encoding_undefined;
-        imap_char_encoding_scheme char_encoding = imap_char_encoding_scheme_default;
-        bool text_part = false, last_octet = false /* last octet bytes ')\r\n' found */;
+        int charset = rd_charset_undefined; // The rd_charset_id of text part
+        bool text_part = false, last_octet = false /* last octet bytes ')\r\n' found */, window_pending = false;
+        bool binary = false; // fetched with BINARY, the content was decoded by server
+        bool binary_rejected = false; // the server rejected the BINARY fetch, fetched with BODY and decoded by client
+        // The decoded data that were not accepted by the sink yet (backpressure), the offset of undelivered data
+        // and the time of the last sink progress.
+        std::vector<uint8_t> sink_buf;
+        size_t sink_offset = 0;
+        unsigned long sink_ms = 0;
+
     };
 
+    // The message header name and value that are valid until the callback returns.
+    typedef struct imap_header_view_t
+    {
+        const char *name = "";
+        const char *value = "";
+        size_t length = 0;
+    } IMAPHeaderView;
+
     // message context
     struct imap_msg_ctx
     {
         int cur_file_index = 0, fetch_count = 0;
+        uint32_t uid = 0;
+        // The remaining octets of current body part literal and the octets requested for ranged fetch.
+        uint32_t octet_remaining = 0, octet_request = 0;
         std::vector<std::pair<String, String>> headers;
+        // The bits of headers index that their values contain the RFC 2047 encoded words which are decoded on first access.
+        uint16_t encoded_headers = 0;
+        // The headers index + 1 of imap_envelope_enum fields, 0 when the field is not in the headers.
+        uint8_t field_headers[imap_envelpe_max_type] = {};
         std::vector<imap_file_ctx> files;
-        String raw_chunk, qp_chunk;
+        String raw_chunk, qp_chunk, item_chunk;
         bool exists = false;
+        // The body part literal octets are counted (multipart or ranged fetch) and the literal fills the requested window.
+        bool octet_counting = false, multipart = false, partial_literal = false;
+        // The BINARY fetch was rejected by server, the body parts are fetched again with BODY.
+        bool binary_retry = false;
+        // The envelope was read from the envelope cache and is not yet processed.
+        bool cached = false;
     };
 
+    class IMAPParser;
+
     class IMAPCallbackData
     {
         friend class IMAPParser;
         friend class IMAPBase;
         friend class IMAPSend;
+        friend class IMAPCache;
 
     public:
         /**
@@ -436,7 +695,43 @@ namespace ReadyMailIMAP
          * @param index The index.
          * @return key-value pair of message header.
          */
-        std::pair<String, String> getHeader(int index) { return (*headers)[index]; }
+        const std::pair<String, String> &getHeader(int index)
+        {
+            decodeHeader(index);
+            return (*headers)[index];
+        }
+
+        /**
+         * Provides a message header at index without copying.
+         *
+         * @param index The index.
+         * @return IMAPHeaderView struct data i.e. name, value and length that are valid until the callback returns.
+         */
+        IMAPHeaderView header(int index)
+        {
+            IMAPHeaderView view;
+            if (index > -1 && index < (int)headers->size())
+            {
+                decodeHeader(index);
+                view.name = (*headers)[index].first.c_str();
+                view.value = (*headers)[index].second.c_str();
+                view.length = (*headers)[index].second.length();
+            }
+            return view;
+        }
+
+        /**
+         * Provides a message header by envelope field without copying.
+         *
+         * @param field The imap_envelope_enum enum e.g. imap_envelpe_subject.
+         * @return IMAPHeaderView struct data, the value is empty when the field was not set by IMAPClient::setEnvelopeFields().
+         */
+        IMAPHeaderView header(imap_envelope_enum field)
+        {
+            if (field < imap_envelpe_max_type && fieldHeaders && fieldHeaders[field] > 0)
+                return header(fieldHeaders[field] - 1);
+            return IMAPHeaderView();
+        }
 
         /**
          * Provides the number of files contains in the messages (included text and message file types).
@@ -503,6 +798,34 @@ namespace ReadyMailIMAP
          */
         void setTextEncodingCallback(int index, IMAPTextDecodingCallback callback) { getFile(index).textEncCb = callback; }
 
+        /**
+         * Set the sink that the decoded data of body part at file index are written to.
+         *
+         * @param index The index.
+         * @param sink The Print or Stream object e.g. File, WiFiClient or HardwareSerial that should be valid until the body part was fetched.
+         *
+         * The partial writes are continued on the next loops until all data were accepted, the fetch is stopped with IMAP_ERROR_PART_SINK error
+         * if the sink does not accept the data within the send timeout or the sink reports the write error.
+         */
+        void setPartSink(int index, Print &sink)
+        {
+            getFile(index).sink = &sink;
+            getFile(index).sinkCb = NULL;
+        }
+
+        /**
+         * Set the write function that the decoded data of body part at file index are written to.
+         *
+         * @param index The index.
+         * @param callback The IMAPPartWriteCallback function that returns the number of bytes accepted,
+         * 0 when it is not ready (the remaining data are written again) or negative value to stop the fetch with IMAP_ERROR_PART_SINK error.
+         */
+        void setPartSink(int index, IMAPPartWriteCallback callback)
+        {
+            getFile(index).sinkCb = callback;
+            getFile(index).sink = nullptr;
+        }
+
         /**
          * Provides current message index from search result.
          * @return The message index.
@@ -532,16 +855,51 @@ namespace ReadyMailIMAP
          */
         uint32_t messageNum(int index = -1) { return msgNums[index > -1 ? index : *msgIndex]; }
 
+        /**
+         * Provides the UID of current message.
+         *
+         * @return The UID of message or 0 if it is not available.
+         */
+        uint32_t messageUID() { return msgUID; }
+
+        /**
+         * Provides the point that the download of body part at file index can be resumed later with IMAPClient::resumeFetch().
+         *
+         * @param index Optional. The index.
+         * Provides -1 or leave default to get the resume point of current file.
+         * @return imap_resume_point struct data i.e. uidValidity, uid, section, offset and index.
+         *
+         * The offset is the number of octets (before transfer decoding) that were received and stored.
+         * The index is the number of decoded bytes that were stored, which is the expected size of partial downloaded file.
+         */
+        imap_resume_point resumePoint(int index = -1)
+        {
+            imap_resume_point point;
+            point.uidValidity = uidValidity;
+            point.uid = msgUID;
+            point.section = getFile(index).section;
+            point.offset = getFile(index).checkpoint;
+            point.index = getFile(index).checkpoint_index;
+            point.binary = getFile(index).binary;
+            return point;
+        }
+
     private:
         int *fileIndex = nullptr;
         int *msgIndex = nullptr;
         int msgFound = 0;
+        uint32_t msgUID = 0, uidValidity = 0;
         std::vector<uint32_t> msgNums;
         imap_data_callback_event eventType = imap_data_event_undefined;
 
         std::vector<imap_file_ctx> *files = nullptr;
         std::vector<std::pair<String, String>> *headers = nullptr;
+        uint16_t *encodedHeaders = nullptr;
+        uint8_t *fieldHeaders = nullptr;
+        IMAPParser *parser = nullptr;
         imap_file_ctx &getFile(int index = -1) { return (*files)[index > -1 ? index : *fileIndex]; }
+        // Defined in Parser.h.
+        void decodeHeader(int index);
     };
 
     typedef void (*IMAPDataCallback)(IMAPCallbackData &data);
@@ -551,6 +909,7 @@ namespace ReadyMailIMAP
         IMAPResponseCallback resp = NULL;
         IMAPDataCallback data = NULL;
         IMAPCustomComandCallback cmd = NULL;
+        IMAPSyncCallback sync = NULL;
         String download_path;
         IMAPCommandResponse command_response;
 #if defined(ENABLE_FS)
@@ -558,19 +917,122 @@ namespace ReadyMailIMAP
 #endif
     };
 
+#if defined(ENABLE_FS)
+    struct imap_cache_ctx
+    {
+        FileCallback cb = NULL;
+        File file;
+        String folder, path;
+        // The UIDVALIDITY of cached mailbox and the size of cache file.
+        uint32_t uid_validity = 0, size = 0;
+        // The message UID and the record offset in the cache file, sorted by UID.
+        std::vector<std::pair<uint32_t, uint32_t>> index;
+    };
+
+    // The download file write buffer, the decoded data are written to file in blocks instead of line by line.
+    struct imap_file_sink_ctx
+    {
+        std::vector<uint8_t> buf;
+        // The block size (0 for unbuffered writes) and the number of block writes between file syncs (0 for no sync).
+        size_t block_size = 4096;
+        uint16_t sync_blocks = 0, blocks = 0;
+    };
+#endif
+
+    // The message number to UID map of selected mailbox.
+    struct imap_uid_map_ctx
+    {
+        // The UIDs in ascending order of the message numbers including the expunged messages,
+        // the UIDs of new messages that are not yet known are 0.
+        std::vector<uint32_t> uids;
+        // The Fenwick tree (1-based) of the existing messages in uids for the message number lookup.
+        std::vector<uint32_t> tree;
+        // The number of existing messages and the number of leading known UIDs.
+        uint32_t count = 0, known = 0;
+        bool built = false;
+        // The first message number of the search and the UIDs in the search result.
+        uint32_t search_start = 0;
+        std::vector<uint32_t> results;
+    };
+
+    // The index of mailboxes list.
+    struct imap_mailbox_dir_ctx
+    {
+        // The nodes and name hashes of mailboxes in the same order as mailboxes list.
+        std::vector<IMAPMailboxNode> nodes;
+        std::vector<uint32_t> hashes;
+        // The open addressing hash table of mailboxes list index, -1 for empty slot.
+        std::vector<int> table;
+        // The mailboxes that were listed in the current LIST response.
+        std::vector<bool> listed;
+        // The first top level mailbox.
+        int root = -1;
+        // The pattern of current LIST command, the unlisted mailboxes that match the pattern are removed.
+        String pattern;
+    };
+
+    struct imap_thread_ctx
+    {
+        // The thread roots are linked from the first node.
+        std::vector<IMAPThreadNode> nodes;
+        // The parsing state that is kept between the split response lines, the parent and the last node of
+        // the parenthesized lists.
+        std::vector<std::pair<int, int>> stack;
+        int parent = -1, last = -1;
+        // The last child of each node and the last thread root for appending.
+        std::vector<int> tails;
+        int root_tail = -1;
+    };
+
+    // The capabilities of server that were known at the last successful authentication.
+    struct imap_caps_entry
+    {
+        String host;
+        uint16_t port = 0;
+        bool auth_caps[imap_auth_cap_max_type] = {}, feature_caps[imap_read_cap_max_type] = {};
+        // The auth mechanism that was accepted e.g. imap_auth_cap_plain, or imap_auth_cap_max_type if unknown.
+        imap_auth_caps_enum mechanism = imap_auth_cap_max_type;
+    };
+
+    // The per-host capability cache, the CAPABILITY command is not sent when the server was cached.
+    struct imap_caps_cache_ctx
+    {
+        bool enabled = false;
+        std::vector<imap_caps_entry> entries;
+        // The cache entry of current server or -1, the cached capabilities were used in current session (hit)
+        // and the entry should be removed before it is used again (stale).
+        int current = -1;
+        bool hit = false, stale = false;
+        // The auth mechanism of current session.
+        imap_auth_caps_enum mechanism = imap_auth_cap_max_type;
+#if defined(ENABLE_FS)
+        FileCallback cb = NULL;
+        File file;
+        String folder;
+        bool loaded = false;
+#endif
+    };
+
     struct imap_context
     {
 #if defined(ENABLE_FS)
         File file;
+        imap_file_sink_ctx file_sink;
+        imap_cache_ctx cache;
 #endif
         Client *client = nullptr;
+#if defined(ENABLE_IMAP_COMPRESS)
+        // The compression layer that replaces the client after COMPRESS DEFLATE.
+        ReadyDeflate deflate;
+#endif
 #if defined(ENABLE_READYCLIENT)
         ReadyClient *auto_client = nullptr;
 #endif
+        ReadyTLSSessionCache *tls_session_cache = nullptr;
         String tag = "ReadyMail", cmd, current_mailbox;
         uint32_t ts = 0;
         int cur_msg_index = 0;
-        bool auth_caps[imap_auth_cap_max_type], feature_caps[imap_read_cap_max_type];
+        bool auth_caps[imap_auth_cap_max_type] = {}, feature_caps[imap_read_cap_max_type] = {};
         std::vector<imap_msg_ctx> messages;
         imap_options options;
         IMAPCallbackData cb_data;
@@ -579,11 +1041,30 @@ namespace ReadyMailIMAP
         imap_server_status_t *server_status = nullptr;
         imap_response_types resp_type = imap_response_undefined;
         std::vector<std::array<String, 3>> *mailboxes = nullptr;
+        std::vector<IMAPMailboxStatus> *mailbox_status = nullptr;
+        imap_mailbox_dir_ctx mailbox_dir;
+        // The digests of the body part that is being decoded.
+        ReadyDigest digest;
+        // The index of next mailbox to send STATUS and the number of STATUS responses to wait.
+        size_t status_index = 0, status_pending = 0;
+        // The indexes of mailboxes that the STATUS commands were sent, in the order of tagged responses.
+        std::vector<size_t> status_sent;
+        // The UTF-8 converted text of text part chunk, the buffer is reused for all chunks of the part.
+        std::vector<uint8_t> text_buf;
         String idle_status;
         bool idle_available = false;
+        imap_idle_queue idle_queue;
+        imap_uid_map_ctx uid_map;
+        imap_thread_ctx thread;
+        imap_caps_cache_ctx caps_cache;
         bool ssl_mode = false;
         bool auth_mode = true;
         uint32_t current_message = 0;
+        imap_resume_point resume_point;
+        imap_sync_point sync_point;
+        String sync_mailbox;
+        // QRESYNC was enabled in this session.
+        bool qresync_enabled = false;
 #if defined(ENABLE_IMAP_APPEND)
         SMTPClient *smtp = nullptr;
         SMTPMessage msg;
@@ -119,6 +119,7 @@ namespace ReadyMailIMAP
             imap_ctx->options.searching = false;
             imap_ctx->options.idling = false;
             imap_ctx->options.processing = false;
+            imap_ctx->options.syncing = false;
         }
 
         void resetProcessFlag()
@@ -131,6 +132,8 @@ namespace ReadyMailIMAP
 
             if (cState() == imap_state_done || cState() == imap_state_idle)
                 imap_ctx->options.idling = false;
+
+            imap_ctx->options.syncing = false;
         }
 
         void releaseSMTP()
@@ -193,7 +196,15 @@ namespace ReadyMailIMAP
             if (forceStop || serverConnected())
                 imap_ctx->client->stop();
 
+#if defined(ENABLE_IMAP_COMPRESS)
+            // Remove the compression layer.
+            if (imap_ctx->client == &imap_ctx->deflate)
+                imap_ctx->client = imap_ctx->deflate.getClient();
+            imap_ctx->deflate.end();
+#endif
+
             serverStatus() = false;
+            imap_ctx->qresync_enabled = false;
             imap_ctx->server_status->secured = false;
             imap_ctx->server_status->server_greeting_ack = false;
             imap_ctx->server_status->authenticated = false;
@@ -290,6 +301,21 @@ namespace ReadyMailIMAP
                 case IMAP_ERROR_FETCH_MESSAGE:
                     msg = "Fetch message failed";
                     break;
+                case IMAP_ERROR_INVALID_RESUME_POINT:
+                    msg = "The resume point is not valid for the selected mailbox";
+                    break;
+                case IMAP_ERROR_COMPRESSION:
+                    msg = "Decompression failed";
+                    break;
+                case IMAP_ERROR_SORT_NOT_SUPPORTED:
+                    msg = "SORT is not supported";
+                    break;
+                case IMAP_ERROR_THREAD_NOT_SUPPORTED:
+                    msg = "THREAD algorithm is not supported";
+                    break;
+                case IMAP_ERROR_PART_SINK:
+                    msg = "Body part sink write failed";
+                    break;
                 default:
                     msg = "Unknown";
                     break;
@@ -0,0 +1,323 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The local cache of message headers and body part info keyed by UIDVALIDITY and UID.
+#ifndef IMAP_CACHE_H
+#define IMAP_CACHE_H
+#if defined(ENABLE_IMAP) && defined(ENABLE_FS)
+#include <Arduino.h>
+#include "Common.h"
+
+#define IMAP_CACHE_SIGNATURE "RMENV1"
+#define IMAP_CACHE_MAX_RECORD_SIZE 8192
+
+namespace ReadyMailIMAP
+{
+    // The cache file of each mailbox begins with the signature and UIDVALIDITY line e.g. "RMENV1 1234567\n"
+    // and follows by the message records "<uid> <length>\n<length octets of record data>".
+    // The record data are the lines of header count, header names and values, file count and file info.
+    class IMAPCache
+    {
+    private:
+        NumString numString;
+
+    public:
+        IMAPCache() {}
+        ~IMAPCache() {}
+
+        bool isEnabled(imap_context *imap_ctx) { return imap_ctx->cache.cb != NULL; }
+
+        // Read the headers and files info of message UID from the cache of selected mailbox.
+        bool read(imap_context *imap_ctx, uint32_t uid, imap_msg_ctx &cmsg)
+        {
+            if (!begin(imap_ctx))
+                return false;
+
+            int i = find(imap_ctx->cache, uid);
+            if (i < 0)
+                return false;
+
+            imap_cache_ctx &cache = imap_ctx->cache;
+            String data;
+            uint32_t rec_uid = 0, len = 0;
+            cache.cb(cache.file, cache.path.c_str(), readymail_file_mode_open_read);
+            if (cache.file && cache.file.seek(cache.index[i].second) && readRecordInfo(cache.file, rec_uid, len) && rec_uid == uid)
+            {
+                data.reserve(len + 1);
+                while (len-- > 0 && cache.file.available())
+                    data += (char)cache.file.read();
+            }
+            close(cache);
+
+            // Only the envelope fields that were set are provided, the record that was written with less fields is not used.
+            uint16_t fields = 0;
+            int pos = 0, count = numString.toNum(nextLine(data, pos).c_str());
+            for (int j = 0; j < count && pos < (int)data.length(); j++)
+            {
+                String name = nextLine(data, pos), value = nextLine(data, pos);
+                int field = getEnvelopeField(name);
+                if (field < imap_envelpe_max_type && (imap_ctx->options.envelope_fields & (1 << field)))
+                {
+                    cmsg.headers.emplace_back(name, value);
+                    cmsg.field_headers[field] = cmsg.headers.size();
+                    fields |= 1 << field;
+                }
+            }
+
+            count = numString.toNum(nextLine(data, pos).c_str());
+            for (int j = 0; j < count && pos < (int)data.length(); j++)
+            {
+                imap_file_ctx cfile;
+                cfile.section = nextLine(data, pos);
+                cfile.octet_count = numString.toNum(nextLine(data, pos).c_str());
+                cfile.info.fileSize = numString.toNum(nextLine(data, pos).c_str());
+                cfile.info.mime = nextLine(data, pos);
+                cfile.info.transferEncoding = nextLine(data, pos);
+                cfile.info.charset = nextLine(data, pos);
+                cfile.info.filename = nextLine(data, pos);
+                cmsg.files.push_back(cfile);
+            }
+
+            if (pos != (int)data.length() || fields != imap_ctx->options.envelope_fields)
+            {
+                // Broken record, the message will be fetched from server.
+                cmsg.headers.clear();
+                memset(cmsg.field_headers, 0, sizeof(cmsg.field_headers));
+                cmsg.files.clear();
+                return false;
+            }
+
+            cmsg.uid = uid;
+            return true;
+        }
+
+        // Append the headers and files info of message to the cache of selected mailbox.
+        void write(imap_context *imap_ctx, const imap_msg_ctx &cmsg)
+        {
+            if (cmsg.uid == 0 || !begin(imap_ctx) || find(imap_ctx->cache, cmsg.uid) > -1)
+                return;
+
+            String data, buf;
+            rd_print_to(data, 20, "%d\n", (int)cmsg.headers.size());
+            for (size_t i = 0; i < cmsg.headers.size(); i++)
+            {
+                addLine(data, cmsg.headers[i].first);
+                addLine(data, cmsg.headers[i].second);
+            }
+
+            rd_print_to(data, 20, "%d\n", (int)cmsg.files.size());
+            for (size_t i = 0; i < cmsg.files.size(); i++)
+            {
+                const imap_file_ctx &cfile = cmsg.files[i];
+                addLine(data, cfile.section);
+                rd_print_to(data, 40, "%u\n%u\n", cfile.octet_count, cfile.info.fileSize);
+                addLine(data, cfile.info.mime);
+                addLine(data, cfile.info.transferEncoding);
+                addLine(data, cfile.info.charset);
+                addLine(data, cfile.info.filename);
+            }
+
+            if (data.length() > IMAP_CACHE_MAX_RECORD_SIZE)
+                return;
+
+            imap_cache_ctx &cache = imap_ctx->cache;
+            rd_print_to(buf, 40, "%u %u\n", cmsg.uid, (uint32_t)data.length());
+            buf += data;
+
+            cache.cb(cache.file, cache.path.c_str(), readymail_file_mode_open_append);
+            if (cache.file && cache.file.write(rd_cast<const uint8_t *>(buf.c_str()), buf.length()) == buf.length())
+            {
+                insert(cache, cmsg.uid, cache.size);
+                cache.size += buf.length();
+            }
+            close(cache);
+        }
+
+        // Remove the cache file of selected mailbox.
+        void remove(imap_context *imap_ctx)
+        {
+            imap_cache_ctx &cache = imap_ctx->cache;
+            if (cache.cb && imap_ctx->current_mailbox.length())
+                cache.cb(cache.file, getPath(imap_ctx).c_str(), readymail_file_mode_remove);
+            reset(cache);
+        }
+
+        void reset(imap_cache_ctx &cache)
+        {
+            clear(cache.path);
+            cache.uid_validity = 0;
+            cache.size = 0;
+            cache.index.clear();
+        }
+
+    private:
+        int getEnvelopeField(const String &name)
+        {
+            int i = imap_envelpe_date;
+            while (i < imap_envelpe_max_type && strcmp(name.c_str(), imap_envelopes[i].text) != 0)
+                i++;
+            return i;
+        }
+
+        // Load the cache index of selected mailbox, the cache file is recreated when UIDVALIDITY was changed.
+        bool begin(imap_context *imap_ctx)
+        {
+            imap_cache_ctx &cache = imap_ctx->cache;
+            uint32_t uid_validity = imap_ctx->cb_data.uidValidity;
+            if (!cache.cb || uid_validity == 0 || imap_ctx->current_mailbox.length() == 0)
+                return false;
+
+            String path = getPath(imap_ctx);
+            if (path == cache.path && uid_validity == cache.uid_validity && cache.size > 0)
+                return true;
+
+            reset(cache);
+            cache.path = path;
+            cache.uid_validity = uid_validity;
+
+            String sig;
+            rd_print_to(sig, 40, "%s %u\n", IMAP_CACHE_SIGNATURE, uid_validity);
+
+            cache.cb(cache.file, path.c_str(), readymail_file_mode_open_read);
+            if (cache.file)
+            {
+                String line;
+                uint32_t pos = readLine(cache.file, line), fsize = cache.file.size(), uid = 0, len = 0;
+                if (line == sig)
+                {
+                    while (pos < fsize && cache.file.seek(pos))
+                    {
+                        int n = readRecordInfo(cache.file, uid, len);
+                        if (n == 0 || pos + n + len > fsize)
+                            break;
+                        insert(cache, uid, pos);
+                        pos += n + len;
+                    }
+                    if (pos == fsize)
+                        cache.size = pos;
+                }
+                close(cache);
+            }
+
+            if (cache.size == 0)
+            {
+                // New, broken or outdated (UIDVALIDITY changed) cache file.
+                cache.index.clear();
+                cache.cb(cache.file, path.c_str(), readymail_file_mode_remove);
+                cache.cb(cache.file, path.c_str(), readymail_file_mode_open_write);
+                if (cache.file && cache.file.write(rd_cast<const uint8_t *>(sig.c_str()), sig.length()) == sig.length())
+                    cache.size = sig.length();
+                close(cache);
+            }
+            return cache.size > 0;
+        }
+
+        String getPath(imap_context *imap_ctx)
+        {
+            // FNV-1a hash of mailbox name as file name.
+            uint32_t hash = 2166136261UL;
+            for (size_t i = 0; i < imap_ctx->current_mailbox.length(); i++)
+            {
+                hash ^= (uint8_t)imap_ctx->current_mailbox[i];
+                hash *= 16777619UL;
+            }
+
+            String path;
+            if (imap_ctx->cache.folder.length() && imap_ctx->cache.folder[0] != '/')
+                path = "/";
+            path += imap_ctx->cache.folder;
+            rd_print_to(path, 20, "/%08lx.env", (unsigned long)hash);
+            return path;
+        }
+
+        // Read the record line "<uid> <length>\n", returns the number of bytes read or 0 if it is not valid.
+        int readRecordInfo(File &file, uint32_t &uid, uint32_t &len)
+        {
+            String line;
+            int n = readLine(file, line);
+            int p = line.indexOf(' ');
+            if (n == 0 || p < 1 || line[line.length() - 1] != '\n')
+                return 0;
+            uid = numString.toNum(line.substring(0, p).c_str());
+            len = numString.toNum(line.substring(p + 1).c_str());
+            return uid > 0 && len > 0 && len <= IMAP_CACHE_MAX_RECORD_SIZE ? n : 0;
+        }
+
+        int readLine(File &file, String &line)
+        {
+            int n = 0;
+            while (file.available() && n < 64)
+            {
+                char c = file.read();
+                line += c;
+                n++;
+                if (c == '\n')
+                    break;
+            }
+            return n;
+        }
+
+        String nextLine(const String &data, int &pos)
+        {
+            int p = data.indexOf('\n', pos);
+            if (p < 0)
+            {
+                pos = data.length() + 1;
+                return "";
+            }
+            String line = data.substring(pos, p);
+            pos = p + 1;
+            return line;
+        }
+
+        void addLine(String &data, const String &value)
+        {
+            String line = value;
+            line.replace("\r", " ");
+            line.replace("\n", " ");
+            data += line;
+            data += "\n";
+        }
+
+        int find(imap_cache_ctx &cache, uint32_t uid)
+        {
+            int low = 0, high = (int)cache.index.size() - 1;
+            while (low <= high)
+            {
+                int mid = (low + high) / 2;
+                if (cache.index[mid].first == uid)
+                    return mid;
+                if (cache.index[mid].first < uid)
+                    low = mid + 1;
+                else
+                    high = mid - 1;
+            }
+            return -1;
+        }
+
+        void insert(imap_cache_ctx &cache, uint32_t uid, uint32_t offset)
+        {
+            // The UIDs are usually added in ascending order.
+            int i = cache.index.size();
+            while (i > 0 && cache.index[i - 1].first > uid)
+                i--;
+            if (i > 0 && cache.index[i - 1].first == uid)
+                cache.index[i - 1].second = offset;
+            else
+                cache.index.insert(cache.index.begin() + i, std::make_pair(uid, offset));
+        }
+
+        void close(imap_cache_ctx &cache)
+        {
+            if (cache.file)
+                cache.file.close();
+        }
+
+        void clear(String &s) { s.remove(0, s.length()); }
+    };
+}
+#endif
+#endif
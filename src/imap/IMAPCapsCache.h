@@ -0,0 +1,298 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The per-host cache of server capabilities and the last accepted auth mechanism.
+#ifndef IMAP_CAPS_CACHE_H
+#define IMAP_CAPS_CACHE_H
+#if defined(ENABLE_IMAP)
+#include <Arduino.h>
+#include "Common.h"
+
+#define IMAP_CAPS_CACHE_SIGNATURE "RMCAP1"
+#define IMAP_CAPS_CACHE_MAX_FILE_SIZE 4096
+
+#if !defined(IMAP_CAPS_CACHE_MAX_ENTRIES)
+#define IMAP_CAPS_CACHE_MAX_ENTRIES 4
+#endif
+
+namespace ReadyMailIMAP
+{
+    // The cached capabilities are used instead of sending the CAPABILITY command after the greeting (and after STARTTLS).
+    // The entry is not checked with the server until it fails, the entry that was used in the session that the authentication
+    // failed or any command got the BAD response is removed on the next connection and the capabilities are requested again.
+    //
+    // The cache file begins with the signature line "RMCAP1\n" and follows by the entry lines (most recent first)
+    // "<host> <port> <mechanism> <capability> ...\n", the mechanism and capabilities are the tokens of CAPABILITY response
+    // e.g. "AUTH=PLAIN" and "-" is used for the unknown mechanism.
+    class IMAPCapsCache
+    {
+    private:
+        NumString numString;
+
+    public:
+        IMAPCapsCache() {}
+        ~IMAPCapsCache() {}
+
+        bool isEnabled(imap_context *imap_ctx) { return imap_ctx->caps_cache.enabled; }
+
+        // Apply the cached capabilities of server, returns false when the server was not cached or the connection is not
+        // encrypted. The cached capabilities (after STARTTLS) never replace the capabilities of unencrypted connection
+        // as the STARTTLS capability of greeting would be cleared.
+        bool apply(imap_context *imap_ctx, const String &host, uint16_t port, bool encrypted)
+        {
+            imap_caps_cache_ctx &cache = imap_ctx->caps_cache;
+            cache.hit = false;
+            if (!cache.enabled)
+                return false;
+
+            load(cache);
+            if (cache.stale && cache.current > -1 && cache.current < (int)cache.entries.size())
+            {
+                cache.entries.erase(cache.entries.begin() + cache.current);
+                save(cache);
+            }
+            cache.stale = false;
+            cache.current = find(cache, host, port);
+            if (cache.current < 0 || !encrypted)
+                return false;
+
+            const imap_caps_entry &entry = cache.entries[cache.current];
+            memcpy(imap_ctx->auth_caps, entry.auth_caps, sizeof(entry.auth_caps));
+            memcpy(imap_ctx->feature_caps, entry.feature_caps, sizeof(entry.feature_caps));
+            cache.hit = true;
+            return true;
+        }
+
+        // Provides the auth mechanism that was accepted by the current server or imap_auth_cap_max_type if it is unknown.
+        imap_auth_caps_enum mechanism(imap_context *imap_ctx)
+        {
+            imap_caps_cache_ctx &cache = imap_ctx->caps_cache;
+            return cache.enabled && !cache.stale && cache.current > -1 && cache.current < (int)cache.entries.size() ? cache.entries[cache.current].mechanism : imap_auth_cap_max_type;
+        }
+
+        // The cached entry of current server should not be used again.
+        void invalidate(imap_context *imap_ctx)
+        {
+            if (imap_ctx->caps_cache.current > -1)
+                imap_ctx->caps_cache.stale = true;
+        }
+
+        // Store the capabilities and the auth mechanism of current server after the successful authentication,
+        // the cache file is written only when the entry was changed.
+        void store(imap_context *imap_ctx, const String &host, uint16_t port)
+        {
+            imap_caps_cache_ctx &cache = imap_ctx->caps_cache;
+            if (!cache.enabled)
+                return;
+
+            load(cache);
+            imap_caps_entry entry;
+            entry.host = host;
+            entry.port = port;
+            memcpy(entry.auth_caps, imap_ctx->auth_caps, sizeof(entry.auth_caps));
+            memcpy(entry.feature_caps, imap_ctx->feature_caps, sizeof(entry.feature_caps));
+            entry.mechanism = cache.mechanism;
+
+            int i = find(cache, host, port);
+            cache.stale = false;
+            if (i > -1 && isEqual(cache.entries[i], entry))
+            {
+                cache.current = i;
+                return;
+            }
+
+            if (i > -1)
+                cache.entries.erase(cache.entries.begin() + i);
+            cache.entries.insert(cache.entries.begin(), entry);
+            if (cache.entries.size() > IMAP_CAPS_CACHE_MAX_ENTRIES)
+                cache.entries.pop_back();
+            cache.current = 0;
+            save(cache);
+        }
+
+        // Remove all entries and the cache file.
+        void remove(imap_context *imap_ctx)
+        {
+            imap_caps_cache_ctx &cache = imap_ctx->caps_cache;
+            reset(cache);
+#if defined(ENABLE_FS)
+            if (cache.cb)
+                cache.cb(cache.file, getPath(cache).c_str(), readymail_file_mode_remove);
+#endif
+        }
+
+        void reset(imap_caps_cache_ctx &cache)
+        {
+            cache.entries.clear();
+            cache.current = -1;
+            cache.hit = false;
+            cache.stale = false;
+#if defined(ENABLE_FS)
+            cache.loaded = false;
+#endif
+        }
+
+    private:
+        int find(imap_caps_cache_ctx &cache, const String &host, uint16_t port)
+        {
+            for (size_t i = 0; i < cache.entries.size(); i++)
+            {
+                if (cache.entries[i].port == port && cache.entries[i].host.equalsIgnoreCase(host))
+                    return i;
+            }
+            return -1;
+        }
+
+        bool isEqual(const imap_caps_entry &a, const imap_caps_entry &b)
+        {
+            return a.mechanism == b.mechanism && memcmp(a.auth_caps, b.auth_caps, sizeof(a.auth_caps)) == 0 && memcmp(a.feature_caps, b.feature_caps, sizeof(a.feature_caps)) == 0;
+        }
+
+#if defined(ENABLE_FS)
+        // Load the entries from the cache file once, the broken file is ignored and will be rewritten.
+        void load(imap_caps_cache_ctx &cache)
+        {
+            if (!cache.cb || cache.loaded)
+                return;
+
+            cache.loaded = true;
+            String data;
+            cache.cb(cache.file, getPath(cache).c_str(), readymail_file_mode_open_read);
+            if (cache.file)
+            {
+                while (cache.file.available() && data.length() < IMAP_CAPS_CACHE_MAX_FILE_SIZE)
+                    data += (char)cache.file.read();
+                cache.file.close();
+            }
+
+            int pos = 0;
+            if (nextLine(data, pos) != IMAP_CAPS_CACHE_SIGNATURE)
+                return;
+
+            while (pos < (int)data.length() && cache.entries.size() < IMAP_CAPS_CACHE_MAX_ENTRIES)
+            {
+                imap_caps_entry entry;
+                if (parseEntry(nextLine(data, pos), entry) && find(cache, entry.host, entry.port) < 0)
+                    cache.entries.push_back(entry);
+            }
+        }
+
+        void save(imap_caps_cache_ctx &cache)
+        {
+            if (!cache.cb)
+                return;
+
+            String data = IMAP_CAPS_CACHE_SIGNATURE;
+            data += "\n";
+            for (size_t i = 0; i < cache.entries.size(); i++)
+            {
+                const imap_caps_entry &entry = cache.entries[i];
+                rd_print_to(data, entry.host.length() + 10, "%s %d ", entry.host.c_str(), entry.port);
+                data += entry.mechanism < imap_auth_cap_max_type ? imap_auth_cap_token[entry.mechanism].text : "-";
+                for (int j = imap_auth_cap_plain; j < imap_auth_cap_max_type; j++)
+                    addToken(data, entry.auth_caps[j], imap_auth_cap_token[j].text);
+                for (int j = imap_read_cap_imap4; j < imap_read_cap_max_type - 1; j++)
+                    addToken(data, entry.feature_caps[j], imap_read_cap_token[j].text);
+                data += "\n";
+            }
+
+            String path = getPath(cache);
+            cache.cb(cache.file, path.c_str(), readymail_file_mode_remove);
+            cache.cb(cache.file, path.c_str(), readymail_file_mode_open_write);
+            if (cache.file)
+            {
+                cache.file.write(rd_cast<const uint8_t *>(data.c_str()), data.length());
+                cache.file.close();
+            }
+        }
+
+        bool parseEntry(const String &line, imap_caps_entry &entry)
+        {
+            int pos = 0, count = 0;
+            String token;
+            while (nextToken(line, pos, token))
+            {
+                if (count == 0)
+                    entry.host = token;
+                else if (count == 1)
+                    entry.port = numString.toNum(token.c_str());
+                else
+                {
+                    for (int j = imap_auth_cap_plain; j < imap_auth_cap_max_type; j++)
+                    {
+                        if (strcmp(token.c_str(), imap_auth_cap_token[j].text) == 0)
+                        {
+                            if (count == 2)
+                                entry.mechanism = (imap_auth_caps_enum)j;
+                            else
+                                entry.auth_caps[j] = true;
+                        }
+                    }
+
+                    for (int j = imap_read_cap_imap4; count > 2 && j < imap_read_cap_max_type - 1; j++)
+                    {
+                        if (strcmp(token.c_str(), imap_read_cap_token[j].text) == 0)
+                            entry.feature_caps[j] = true;
+                    }
+                }
+                count++;
+            }
+            return count > 2 && entry.host.length() > 0 && entry.port > 0;
+        }
+
+        void addToken(String &data, bool cap, const char *token)
+        {
+            if (cap)
+            {
+                data += " ";
+                data += token;
+            }
+        }
+
+        bool nextToken(const String &line, int &pos, String &token)
+        {
+            while (pos < (int)line.length() && line[pos] == ' ')
+                pos++;
+            if (pos >= (int)line.length())
+                return false;
+            int p = line.indexOf(' ', pos);
+            if (p < 0)
+                p = line.length();
+            token = line.substring(pos, p);
+            pos = p;
+            return true;
+        }
+
+        String nextLine(const String &data, int &pos)
+        {
+            int p = data.indexOf('\n', pos);
+            if (p < 0)
+            {
+                pos = data.length();
+                return "";
+            }
+            String line = data.substring(pos, p);
+            pos = p + 1;
+            return line;
+        }
+
+        String getPath(imap_caps_cache_ctx &cache)
+        {
+            String path;
+            if (cache.folder.length() && cache.folder[0] != '/')
+                path = "/";
+            path += cache.folder;
+            path += "/imap.cap";
+            return path;
+        }
+#else
+        void load(imap_caps_cache_ctx &cache) { (void)cache; }
+        void save(imap_caps_cache_ctx &cache) { (void)cache; }
+#endif
+    };
+}
+#endif
+#endif
@@ -17,16 +17,28 @@
 using namespace ReadyMailIMAP;
 using namespace ReadyMailCallbackNS;
 
+class ReadyMailScheduler;
+class ReadyMailLoop;
+
 namespace ReadyMailIMAP
 {
     class IMAPClient
     {
+        friend class IMAPSessionPool;
+        friend class ::ReadyMailScheduler;
+        friend class ::ReadyMailLoop;
+
     public:
         /** Provides the list of mailboxes from IMAPClient::list() function.
          * Each item contains array of String represents attributes, delimiter and name properties of each mailbox.
          */
         std::vector<std::array<String, 3>> mailboxes;
 
+        /** Provides the list of mailbox status from IMAPClient::listStatus() function.
+         * Each item contains the name, the number of messages, unseen messages and the next UID of mailbox.
+         */
+        std::vector<IMAPMailboxStatus> mailboxStatus;
+
         /** IMAPClient class constructor.
          *  The IMAPClient::begin() is needed to start using the client.
          *
@@ -36,6 +48,7 @@ namespace ReadyMailIMAP
             imap_ctx.server_status = &server_status;
             imap_ctx.status = &resp_status;
             imap_ctx.mailboxes = &mailboxes;
+            imap_ctx.mailbox_status = &mailboxStatus;
             conn.begin(&imap_ctx, NULL, &res);
             sender.begin(&imap_ctx, &res, &conn);
         }
@@ -93,6 +106,7 @@ namespace ReadyMailIMAP
             imap_ctx.server_status = &server_status;
             imap_ctx.status = &resp_status;
             imap_ctx.mailboxes = &mailboxes;
+            imap_ctx.mailbox_status = &mailboxStatus;
             imap_ctx.auth_mode = true;
             conn.begin(&imap_ctx, tlsCallback, &res);
             sender.begin(&imap_ctx, &res, &conn);
@@ -113,6 +127,7 @@ namespace ReadyMailIMAP
             imap_ctx.server_status = &server_status;
             imap_ctx.status = &resp_status;
             imap_ctx.mailboxes = &mailboxes;
+            imap_ctx.mailbox_status = &mailboxStatus;
             imap_ctx.auth_mode = true;
             conn.begin(&imap_ctx, NULL, &res);
             sender.begin(&imap_ctx, &res, &conn);
@@ -235,6 +250,176 @@ namespace ReadyMailIMAP
             conn.begin(&imap_ctx, tlsCallback, &res);
         }
 
+#if defined(ENABLE_IMAP_COMPRESS)
+        /** Set the option to enable the COMPRESS=DEFLATE extension (RFC 4978).
+         *
+         * @param value The value. True for requesting the compression after authentication if the server supports it.
+         * @param windowBits Optional. The window bits (9 to 15) of inflate window that uses 1 << windowBits bytes of RAM.
+         * The window should not be smaller than the server's deflate window (usually 15), the session will be stopped
+         * with IMAP_ERROR_COMPRESSION error if the server data refers beyond the window.
+         *
+         * This should be set before IMAPClient::authenticate().
+         */
+        void setCompression(bool value, uint8_t windowBits = 15)
+        {
+            imap_ctx.options.compress = value;
+            imap_ctx.options.compress_window_bits = windowBits;
+        }
+#endif
+
+        /** Set the option to fetch the message body parts in single FETCH command.
+         *
+         * @param value The value. True for requesting all body parts that are set to fetch in one FETCH command,
+         * false for requesting one body part per FETCH command (default).
+         *
+         * This saves the server round trips when the message contains many parts (text, html and attachments).
+         */
+        void setMultipartFetch(bool value) { imap_ctx.options.multipart_fetch = value; }
+
+        /** Set the maximum size of body part content to request per FETCH command.
+         *
+         * @param size The number of octets (before transfer decoding) per window e.g. 16384. Set 0 to request the whole part (default).
+         *
+         * The large body part is fetched in bounded windows with BODY.PEEK[section]<offset.size>,
+         * the body parts are then requested one part per FETCH command regardless of IMAPClient::setMultipartFetch().
+         */
+        void setFetchWindow(uint32_t size) { imap_ctx.options.fetch_window = size; }
+
+        /** Set the option to fetch the non-text body parts (attachments) with BINARY.PEEK[section] when the server supports the BINARY extension.
+         *
+         * @param value The boolean option to enable the BINARY fetch.
+         *
+         * The server decodes the content transfer encoding, the octets are then received without base64 overhead
+         * and stored to file or provided in the data callback without decoding.
+         * The body part that the server rejects the BINARY fetch (e.g. NO [UNKNOWN-CTE]) is fetched again with BODY.PEEK[section] and decoded by the client.
+         */
+        void setBinaryFetch(bool value) { imap_ctx.options.binary_fetch = value; }
+
+        /** Set the envelope fields to decode and store in the message headers.
+         *
+         * @param fields The bits of imap_envelope_enum e.g. (1 << imap_envelpe_from) | (1 << imap_envelpe_subject).
+         * The default is IMAP_ENVELOPE_ALL_FIELDS.
+         *
+         * The fields that are not set are not decoded and not provided by IMAPCallbackData::getHeader() and IMAPCallbackData::header().
+         */
+        void setEnvelopeFields(uint16_t fields) { imap_ctx.options.envelope_fields = fields & IMAP_ENVELOPE_ALL_FIELDS; }
+
+        /** Set the digests to compute from the decoded content of fetched body parts.
+         *
+         * @param types The bits of readymail_digest_type e.g. readymail_digest_md5 | readymail_digest_sha256, readymail_digest_none to disable (default).
+         *
+         * The digests are computed while the body part is decoded and are available from IMAPCallbackData::fileInfo().md5
+         * and IMAPCallbackData::fileInfo().sha256 when the file chunk is complete. The body part that was resumed
+         * with IMAPClient::resumeFetch() has no digest.
+         */
+        void setDigest(uint8_t types) { imap_ctx.options.digest_types = types; }
+
+        /** Set how the blocking (await) operations wait for the server response.
+         *
+         * @param mode The readymail_wait_mode e.g. readymail_wait_yield (default), readymail_wait_sleep or readymail_wait_callback.
+         * @param timeoutMs The timeout hint in milliseconds that is slept or provided to the WaitCallback function. The default is 10 ms.
+         * @param cb Optional. The WaitCallback function that is used with readymail_wait_callback mode.
+         *
+         * The wait starts only when the server response is pending and no data is available, the read timeout is still applied.
+         * The WaitCallback function can wait for the socket readiness e.g. poll() or the task notification and should return
+         * when the client is readable or the timeout hint is reached.
+         */
+        void setWaitStrategy(readymail_wait_mode mode, uint32_t timeoutMs = 10, WaitCallback cb = NULL)
+        {
+            imap_ctx.options.wait.mode = mode;
+            imap_ctx.options.wait.timeout = timeoutMs;
+            imap_ctx.options.wait.cb = cb;
+        }
+
+        /** Set the TLS session cache for the session resumption.
+         *
+         * @param cache The ReadyTLSSessionCache class object that can be shared by many clients.
+         *
+         * The cached session of host and port is applied to the SSL client before the TLS handshake (in connect() of SSL client,
+         * TLSHandshakeCallback function or STARTTLS) and it is updated when the service is ready, the session resumption
+         * skips the full handshake. When this is not set, the session cache of ReadyClient is used.
+         */
+        void setTLSSessionCache(ReadyTLSSessionCache &cache) { imap_ctx.tls_session_cache = &cache; }
+
+        /** Set the in-memory capability cache of the servers.
+         *
+         * @param enable The boolean option to enable the cache.
+         *
+         * The capabilities and the auth mechanism that was accepted by the server are cached (per host and port) after
+         * the successful authentication. When the client is connected to the cached server again, the CAPABILITY command
+         * is not sent on the SSL connection or after STARTTLS. The cached entry is used until it fails, the entry that was used in
+         * the session that the authentication failed or any command got the BAD response is removed on the next connection.
+         */
+        void setCapabilityCache(bool enable)
+        {
+            conn.caps_cache.reset(imap_ctx.caps_cache);
+            imap_ctx.caps_cache.enabled = enable;
+#if defined(ENABLE_FS)
+            imap_ctx.caps_cache.cb = NULL;
+#endif
+        }
+
+#if defined(ENABLE_FS)
+        /** Set the capability cache of the servers that is persisted to file.
+         *
+         * @param fileCallback The FileCallback callback function that provides the file openning and removing operations for the cache file.
+         * @param cacheFolder Optional. The name of folder that stores the cache file.
+         *
+         * The cache file (imap.cap) is loaded at the first connection and it is written only when the cached entries were changed,
+         * see IMAPClient::setCapabilityCache(bool). Use IMAPClient::setCapabilityCache(false) to disable the cache.
+         */
+        void setCapabilityCacheFile(FileCallback fileCallback, const String &cacheFolder = "")
+        {
+            conn.caps_cache.reset(imap_ctx.caps_cache);
+            imap_ctx.caps_cache.enabled = fileCallback != NULL;
+            imap_ctx.caps_cache.cb = fileCallback;
+            imap_ctx.caps_cache.folder = cacheFolder;
+        }
+#endif
+
+        /** Remove all cached capabilities and the cache file.
+         */
+        void clearCapabilityCache() { conn.caps_cache.remove(&imap_ctx); }
+
+#if defined(ENABLE_FS)
+        /** Set the local cache of message envelopes (headers and body part info).
+         *
+         * @param fileCallback The FileCallback callback function that provides the file openning and removing operations for the cache files.
+         * Set NULL to disable the cache.
+         * @param cacheFolder Optional. The name of folder that stores the cache files.
+         *
+         * The envelope of message that was fetched is added to the cache file of the mailbox (one file per mailbox).
+         * When the message is fetched by UID (IMAPClient::fetchUID() or UID SEARCH), the envelope of the UID in cache
+         * is read from file instead of sending the FETCH command, only the new UIDs are fetched from server.
+         * The cache file is recreated when the UIDVALIDITY of mailbox was changed.
+         */
+        void setEnvelopeCache(FileCallback fileCallback, const String &cacheFolder = "")
+        {
+            res.parser.cache.reset(imap_ctx.cache);
+            imap_ctx.cache.cb = fileCallback;
+            imap_ctx.cache.folder = cacheFolder;
+        }
+
+        /** Remove the envelope cache file of selected mailbox.
+         */
+        void clearEnvelopeCache() { res.parser.cache.remove(&imap_ctx); }
+
+        /** Set the write buffer of the downloaded files.
+         *
+         * @param blockSize The size of data block that is written to file e.g. 4096 (default) to match the flash page or sector size.
+         * Set 0 to write the decoded data to file as it is received (one write per line).
+         * @param syncBlocks Optional. The number of block writes before syncing the file with File::flush(), 0 for no sync until the file is closed.
+         *
+         * The buffer is allocated while the file is downloading and written to file when the body part is complete.
+         * The resume point of the body part (IMAPCallbackData::resumePoint()) only covers the data that were written to file.
+         */
+        void setDownloadBuffer(size_t blockSize, uint16_t syncBlocks = 0)
+        {
+            imap_ctx.file_sink.block_size = blockSize;
+            imap_ctx.file_sink.sync_blocks = syncBlocks;
+        }
+#endif
+
         /** Send command to IMAP server.
          *
          * @param cmd The command to send.
@@ -274,7 +459,7 @@ namespace ReadyMailIMAP
 
             imap_ctx.cb.cmd = cb;
 
-            if (lcmd.indexOf(" create") > -1 || lcmd.indexOf(" delete") > -1)
+            if (lcmd.indexOf(" create") > -1 || lcmd.indexOf(" delete") > -1 || lcmd.indexOf(" rename") > -1)
                 imap_ctx.options.mailboxes_updated = true;
 
             bool ret = sender.sendCmd(cmd);
@@ -302,9 +487,47 @@ namespace ReadyMailIMAP
          * [+] 123456 When the message number 123456 was added to the mailbox or new message is arrived.
          * [-] 123456 When the message number 123456 was removed or deleted from mailbox.
          * [=][/aaa /bbb ] 123456 When the message number 123456 status was changed as the existing flag /aaa and /bbb are assigned
+         * [-][UID] 41,43:116 When the messages UID 41 and 43 to 116 were removed from mailbox (after QRESYNC was enabled by IMAPClient::sync()).
          */
         String idleStatus() { return imap_ctx.idle_status; }
 
+        /** Provides the number of IDLE events in the event queue.
+         *
+         * @return number of queued events.
+         * The events are kept until they were read by IMAPClient::readIdleEvent() or the new mailbox was selected.
+         */
+        int idleEventAvailable() { return imap_ctx.idle_queue.count; }
+
+        /** Read and remove the oldest IDLE event from the event queue.
+         *
+         * @param event The IMAPIdleEvent struct data to receive the event i.e. type, msgNum, count and flags.
+         * @return boolean status of the event reading. It returns false when the event queue is empty.
+         */
+        bool readIdleEvent(IMAPIdleEvent &event)
+        {
+            imap_idle_queue &queue = imap_ctx.idle_queue;
+            if (queue.count == 0)
+                return false;
+            event = queue.events[queue.head];
+            queue.head = (queue.head + 1) % IMAP_IDLE_EVENT_QUEUE_SIZE;
+            queue.count--;
+            return true;
+        }
+
+        /** Set the IDLE events coalescing option.
+         *
+         * @param enable The boolean option to merge the consecutive IDLE events of the same type in the adjacent message range
+         * e.g. the 50 EXISTS responses will be queued as one imap_idle_event_exists event with count 50. The default is true.
+         */
+        void setIdleEventCoalescing(bool enable) { imap_ctx.idle_queue.coalesce = enable; }
+
+        /** Provides the number of oldest IDLE events that were overwritten because the event queue was full.
+         *
+         * @return number of dropped events.
+         * The event queue size can be changed by defining IMAP_IDLE_EVENT_QUEUE_SIZE macro (default is 16).
+         */
+        uint32_t idleEventDropped() { return imap_ctx.idle_queue.dropped; }
+
         /** Provides the current message index in the search result message list while fetching the message's envelope.
          *
          * @return number of index.
@@ -335,6 +558,85 @@ namespace ReadyMailIMAP
             return ret;
         }
 
+        /** List the mailboxes with the number of messages, unseen messages and the next UID without selecting them.
+         *
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * The actual result stores IMAPClient::mailboxStatus list and the mailboxes are also stored in IMAPClient::mailboxes list.
+         * The LIST-STATUS extension (RFC 5819) is used when it is supported, otherwise the STATUS commands of listed mailboxes
+         * are sent at once in group of IMAP_STATUS_PIPELINE_SIZE (default is 8). The mailbox that cannot be accessed is skipped.
+         */
+        bool listStatus(bool await = true)
+        {
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_list, "Listing mailboxes status...");
+#endif
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, false))
+                return false;
+
+            if (imap_ctx.options.idling)
+                sendDone();
+
+            bool ret = sender.listStatus();
+            if (ret && await && imap_ctx.options.processing)
+                return awaitLoop();
+            return ret;
+        }
+
+        /** Refresh the mailboxes that match the pattern.
+         *
+         * @param pattern The LIST command mailbox pattern e.g. "Archive/%" or "Archive*".
+         * The "*" matches any characters and "%" matches any characters except the hierarchy delimiter.
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * The listed mailboxes are updated or added to IMAPClient::mailboxes list and the mailboxes that match
+         * the pattern but were not listed are removed. The other mailboxes are kept as they are.
+         */
+        bool refreshMailboxes(const String &pattern, bool await = true)
+        {
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_list, "Refreshing mailboxes...");
+#endif
+
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, false))
+                return false;
+
+            if (imap_ctx.options.idling)
+                sendDone();
+
+            bool ret = sender.list(pattern);
+            if (ret && await)
+                return awaitLoop();
+            return ret;
+        }
+
+        /** Find the mailbox in IMAPClient::mailboxes list.
+         *
+         * @param name The name of folder/mailbox.
+         * @return index of mailbox in IMAPClient::mailboxes list or -1 if it was not listed.
+         */
+        int findMailbox(const String &name) { return res.parser.mailbox_dir.find(&imap_ctx, name); }
+
+        /** Provides the hierarchy and attributes of mailbox.
+         *
+         * @param index The index of mailbox in IMAPClient::mailboxes list.
+         * @return IMAPMailboxNode object that provides the parent, first child and next sibling mailbox indexes (-1 for none)
+         * and the imap_mailbox_attribute bits. For index -1, the first child is the first top level mailbox.
+         */
+        IMAPMailboxNode mailboxNode(int index) { return res.parser.mailbox_dir.node(&imap_ctx, index); }
+
         /** Provides the information of selected mailbox.
          * @return MailboxInfo object.
          */
@@ -373,6 +675,114 @@ namespace ReadyMailIMAP
             return ret;
         }
 
+        /** Select the mailbox and provide the changes since the stored mailbox state (incremental resynchronization).
+         *
+         * @param mailbox The name of folder/mailbox to select.
+         * @param point The imap_sync_point that provides from IMAPClient::getSyncPoint() at the end of last session.
+         * Use empty (default) imap_sync_point for the first synchronization.
+         * @param syncCallback The IMAPSyncCallback callback function that provides the changes.
+         * @param readOnly Optional. The boolean option for selecting the mailbox in read only mode.
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * This requires the server that supports CONDSTORE or QRESYNC extension (RFC 7162).
+         * With QRESYNC, the flag changes and the expunged messages (imap_sync_event_vanished) are reported in the SELECT response.
+         * With CONDSTORE, the flag changes and the new messages are fetched with UID FETCH 1:* (FLAGS) (CHANGEDSINCE modseq),
+         * the expunged messages are not reported.
+         * If the UIDVALIDITY of mailbox was changed, the imap_sync_event_invalidated event is provided and the client should
+         * discard the stored messages and synchronize the mailbox again.
+         */
+        bool sync(const String &mailbox, const imap_sync_point &point, IMAPSyncCallback syncCallback, bool readOnly = true, bool await = true)
+        {
+            validateMailboxesChange();
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_sync, "Synchronizing \"" + mailbox + "\"...");
+#endif
+
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, false))
+                return false;
+
+            if (!imap_ctx.feature_caps[imap_read_cap_condstore] && !imap_ctx.feature_caps[imap_read_cap_qresync])
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_MODSEQ_WAS_NOT_SUPPORTED);
+
+            if (imap_ctx.options.idling)
+                sendDone();
+
+            imap_ctx.cb.sync = syncCallback;
+            imap_ctx.sync_point = point;
+
+            bool ret = sender.sync(mailbox, readOnly ? mailbox_mode_examine : mailbox_mode_select);
+            if (ret && await)
+                return awaitLoop();
+            return ret;
+        }
+
+        /** Build or update the message number to UID map of selected mailbox.
+         *
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * The map is built with UID SEARCH ALL (or ESEARCH when it is supported) and then it is updated from the
+         * EXPUNGE, VANISHED and EXISTS responses without server round-trip. The UIDs of new messages are unknown (0)
+         * until this function is called again which searches only the new messages.
+         * The map is cleared when the mailbox is selected or closed.
+         */
+        bool updateUIDMap(bool await = true)
+        {
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_uid_map, "Updating the UID map of \"" + imap_ctx.current_mailbox + "\"...");
+#endif
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, true))
+                return false;
+
+            if (res.parser.uid_map.isBuilt(imap_ctx.uid_map) && res.parser.uid_map.firstUnknown(imap_ctx.uid_map) == 0)
+                return true;
+
+            if (imap_ctx.options.idling)
+                sendDone();
+
+            bool ret = sender.updateUIDMap();
+            if (ret && await)
+                return awaitLoop();
+            return ret;
+        }
+
+        /** Provides the UID of message number from the UID map (IMAPClient::updateUIDMap).
+         *
+         * @param msgNum The message number.
+         * @return number of message UID or 0 if it is unknown.
+         */
+        uint32_t getUID(uint32_t msgNum) { return res.parser.uid_map.uid(imap_ctx.uid_map, msgNum); }
+
+        /** Provides the message number of UID from the UID map (IMAPClient::updateUIDMap).
+         *
+         * @param uid The message UID.
+         * @return number of message or 0 if it is unknown or was removed.
+         */
+        uint32_t getMsgNum(uint32_t uid) { return res.parser.uid_map.msgNum(imap_ctx.uid_map, uid); }
+
+        /** Provides the state of selected mailbox to store for the next IMAPClient::sync().
+         *
+         * @return imap_sync_point struct data i.e. uidValidity and highestModseq.
+         */
+        imap_sync_point getSyncPoint()
+        {
+            imap_sync_point point;
+            point.uidValidity = res.mailbox_info.UIDValidity;
+            point.highestModseq = res.mailbox_info.highestModseq;
+            return point;
+        }
+
         /** De-select or close the mailboxe.
          *
          * @param await Optional. The boolean option for using in await or blocking mode.
@@ -580,6 +990,7 @@ namespace ReadyMailIMAP
                 return sender.setError(&imap_ctx, __func__, IMAP_ERROR_MODSEQ_WAS_NOT_SUPPORTED);
 
             imap_ctx.options.search_limit = searchLimit;
+            imap_ctx.options.resume = false;
             imap_ctx.options.recent_sort = recentSort;
             imap_ctx.cb.data = dataCallback;
 
@@ -589,6 +1000,86 @@ namespace ReadyMailIMAP
             return ret;
         }
 
+        /** Sort the messages in selected mailbox on the server (RFC 5256).
+         *
+         * @param criteria The list of IMAPSortCriterion i.e. the imap_sort_key and its reverse order option e.g. {{imap_sort_key_date, true}}
+         * for the newest messages first. The next criterion is used when the messages are equal by the previous criterion.
+         * @param searchKeys The search keys of messages to sort e.g. "ALL" or "UNSEEN SINCE 10-Feb-2019", see IMAPClient::search().
+         * @param sortLimit The maximum number of message (number or UID) that can store in the message list.
+         * @param dataCallback The IMAPDataCallback callback function that provides the instant information of processing state.
+         * The envelopes of the first sortLimit messages in the sorted order are fetched when it is set.
+         * @param uidSort Optional. The boolean option to get the message UIDs instead of the message numbers.
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * The result is stored in IMAPClient::searchResult() list in the sorted order.
+         */
+        bool sort(const std::vector<IMAPSortCriterion> &criteria, const String &searchKeys, uint32_t sortLimit, IMAPDataCallback dataCallback, bool uidSort = false, bool await = true)
+        {
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_sort, "Sorting \"" + imap_ctx.current_mailbox + "\"...");
+#endif
+
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, true))
+                return false;
+
+            if (!imap_ctx.feature_caps[imap_read_cap_sort])
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_SORT_NOT_SUPPORTED);
+
+            if (!validSearchKeys(searchKeys) || criteria.size() == 0)
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_INVALID_SEARCH_CRITERIA);
+
+            imap_ctx.options.search_limit = sortLimit;
+            imap_ctx.options.resume = false;
+            imap_ctx.cb.data = dataCallback;
+
+            bool ret = sender.sort(criteria, searchKeys, uidSort);
+            if (ret && await)
+                return awaitLoop();
+            return ret;
+        }
+
+        /** Group the messages in selected mailbox into threads on the server (RFC 5256).
+         *
+         * @param algorithm The imap_thread_algorithm enum i.e. imap_thread_references and imap_thread_orderedsubject.
+         * @param searchKeys The search keys of messages to thread e.g. "ALL" or "SINCE 10-Feb-2019", see IMAPClient::search().
+         * @param uidThread Optional. The boolean option to get the message UIDs instead of the message numbers.
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @return boolean status of processing state.
+         *
+         * The result is stored in IMAPClient::threadResult() list.
+         */
+        bool thread(imap_thread_algorithm algorithm, const String &searchKeys, bool uidThread = false, bool await = true)
+        {
+#if defined(ENABLE_DEBUG)
+            sender.setDebugState(imap_state_thread, "Threading \"" + imap_ctx.current_mailbox + "\"...");
+#endif
+
+            if (!conn.isInitialized() || !conn.isIdleState(__func__))
+                return false;
+
+            if (!ready(__func__, true))
+                return false;
+
+            if (!imap_ctx.feature_caps[algorithm == imap_thread_references ? imap_read_cap_thread_references : imap_read_cap_thread_orderedsubject])
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_THREAD_NOT_SUPPORTED);
+
+            if (!validSearchKeys(searchKeys))
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_INVALID_SEARCH_CRITERIA);
+
+            bool ret = sender.thread(algorithm, searchKeys, uidThread);
+            if (ret && await)
+                return awaitLoop();
+            return ret;
+        }
+
         /** Fetch the message in selected mailbox by UID.
          *
          * @param uid The message UID.
@@ -612,6 +1103,7 @@ namespace ReadyMailIMAP
     (void)downloadFolder;
 #endif
             imap_ctx.cb.data = dataCallback;
+            imap_ctx.options.resume = false;
             return fetchImpl(uid, true, await, bodySizeLimit);
         }
 
@@ -638,15 +1130,58 @@ namespace ReadyMailIMAP
     (void)downloadFolder;
 #endif
             imap_ctx.cb.data = dataCallback;
+            imap_ctx.options.resume = false;
             return fetchImpl(number, false, await, bodySizeLimit);
         }
 
-        /** Provides the message list of number or UID from search.
+        /** Resume the body part download of message in selected mailbox.
+         *
+         * @param point The imap_resume_point that provides from IMAPCallbackData::resumePoint() while fetching.
+         * @param dataCallback The IMAPDataCallback callback function that provides the instant information of processing state.
+         * @param fileCallback Optional. The FileCallback callback function that provides the file openning and removing operations for file/attachment download.
+         * The file will be opened in append mode.
+         * @param await Optional. The boolean option for using in await or blocking mode.
+         * For async mode, set this parameter with false and calling the IMAPClient::loop() in the loop
+         * to handle the async processes.
+         * @param downloadFolder The name of folder that stores the downloaded files.
+         * @return boolean status of processing state.
+         *
+         * Only the body part of resume point will be fetched, starting from the octet offset of resume point.
+         * The resume point is invalid when the UIDVALIDITY of selected mailbox was changed.
+         * The download folder is named by the fetch number, fetch the message with IMAPClient::fetchUID() for the same file to be appended.
+         */
+        bool resumeFetch(const imap_resume_point &point, IMAPDataCallback dataCallback, FileCallback fileCallback = NULL, bool await = true, const String &downloadFolder = "")
+        {
+            validateMailboxesChange();
+            if (point.uid == 0 || point.section.length() == 0 || (res.mailbox_info.UIDValidity > 0 && point.uidValidity != res.mailbox_info.UIDValidity))
+                return sender.setError(&imap_ctx, __func__, IMAP_ERROR_INVALID_RESUME_POINT);
+#if defined(ENABLE_FS)
+            imap_ctx.cb.file = fileCallback;
+            imap_ctx.cb.download_path = downloadFolder;
+#else
+    (void)fileCallback;
+    (void)downloadFolder;
+#endif
+            imap_ctx.cb.data = dataCallback;
+            imap_ctx.resume_point = point;
+            imap_ctx.options.resume = true;
+            return fetchImpl(point.uid, true, await, 0xffffffff);
+        }
+
+        /** Provides the message list of number or UID from search or sort.
          *
          * @return std::vector<uint32_t> list or array.
          */
         std::vector<uint32_t> &searchResult() { return sender.msgNumVec(); }
 
+        /** Provides the message tree from IMAPClient::thread().
+         *
+         * @return The list of IMAPThreadNode that provides the message number or UID (0 for the missing parent message),
+         * and the parent, first child and next sibling node indexes (-1 for none).
+         * The first thread root is the node at index 0 and the next thread roots are linked by the nextSibling.
+         */
+        std::vector<IMAPThreadNode> &threadResult() { return imap_ctx.thread.nodes; }
+
         /** Provides the command response when using IMAPClient::sendCommand().
          *
          * @return String of untagged response.
@@ -676,11 +1211,25 @@ namespace ReadyMailIMAP
                 code = conn.loop();
                 if (code != function_return_failure)
                     code = sender.loop();
+                // The undefined code is for awaiting the server response.
+                if (code == function_return_undefined)
+                    imap_ctx.options.wait.wait(imap_ctx.client, netClient());
+                rd_await_step(this);
             }
             imap_ctx.server_status->state_info.state = imap_state_prompt;
             return code != function_return_failure;
         }
 
+        // The network client under the compression layer.
+        Client *netClient()
+        {
+#if defined(ENABLE_IMAP_COMPRESS)
+            if (imap_ctx.client == &imap_ctx.deflate)
+                return imap_ctx.deflate.getClient();
+#endif
+            return imap_ctx.client;
+        }
+
         bool authImpl(const String &email, const String &param, readymail_auth_type auth, bool await = true)
         {
             if (auth == readymail_auth_disabled)
@@ -752,6 +1301,14 @@ namespace ReadyMailIMAP
             return ret;
         }
 
+        // The search keys for SORT and THREAD should not be the complete command.
+        bool validSearchKeys(const String &searchKeys)
+        {
+            String keys = " " + searchKeys;
+            keys.toLowerCase();
+            return searchKeys.length() > 0 && keys.indexOf(" search ") == -1 && keys.indexOf(" fetch ") == -1 && keys.indexOf(" sort ") == -1 && keys.indexOf(" thread ") == -1;
+        }
+
         bool ready(const char *func, bool checkMailbox)
         {
             if (!isConnected())
@@ -12,6 +12,7 @@
 #include "IMAPBase.h"
 #include "IMAPResponse.h"
 #include "IMAPSend.h"
+#include "IMAPCapsCache.h"
 
 using namespace ReadyMailCallbackNS;
 
@@ -60,9 +61,17 @@ namespace ReadyMailIMAP
             if (!isInitialized())
                 return false;
 
+            // The SSL client performs the handshake in connect() when the TLS upgrade is not used.
+            tls_session.reset();
+            bool handshake = imap_ctx->ssl_mode && !imap_ctx->server_status->start_tls && !tls_cb;
+            if (handshake)
+                applyTLSSession();
+
             serverStatus() = imap_ctx->client->connect(host.c_str(), port);
             if (!serverStatus())
             {
+                if (handshake)
+                    tls_session.fail();
                 stop(conn_timer.remaining() == 0);
                 if (imap_ctx->cb.resp)
                     setError(imap_ctx, __func__, conn_timer.remaining() == 0 ? TCP_CLIENT_ERROR_CONNECTION_TIMEOUT : TCP_CLIENT_ERROR_CONNECTION);
@@ -117,6 +126,10 @@ namespace ReadyMailIMAP
             bool sasl_login = imap_ctx->auth_caps[imap_auth_cap_login] && user;
             bool sasl_auth_plain = imap_ctx->auth_caps[imap_auth_cap_plain] && user;
 
+            // The mechanism that was accepted by the server in the last session is used again.
+            if (sasl_login && caps_cache.mechanism(imap_ctx) == imap_auth_cap_login)
+                sasl_auth_plain = false;
+
             if (sasl_auth_oauth)
             {
                 if (!imap_ctx->auth_caps[imap_auth_cap_xoauth2])
@@ -125,12 +138,14 @@ namespace ReadyMailIMAP
                 if (!tcpSend(true, 7, imap_ctx->tag.c_str(), " ", "AUTHENTICATE", " ", "XOAUTH2", imap_ctx->auth_caps[imap_auth_cap_sasl_ir] ? " " : "", imap_ctx->auth_caps[imap_auth_cap_sasl_ir] ? rd_enc_oauth(email, access_token).c_str() : ""))
                     return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
 
+                imap_ctx->caps_cache.mechanism = imap_auth_cap_xoauth2;
                 setState(imap_state_auth_xoauth2);
             }
             else if (sasl_auth_plain)
             {
                 if (!tcpSend(true, 7, imap_ctx->tag.c_str(), " ", "AUTHENTICATE", " ", "PLAIN", imap_ctx->auth_caps[imap_auth_cap_sasl_ir] ? " " : "", imap_ctx->auth_caps[imap_auth_cap_sasl_ir] ? rd_enc_plain(email, password).c_str() : ""))
                     return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+                imap_ctx->caps_cache.mechanism = imap_auth_cap_plain;
                 setState(imap_state_auth_plain);
             }
             else if (sasl_login)
@@ -138,6 +153,7 @@ namespace ReadyMailIMAP
                 if (!tcpSend(true, 7, imap_ctx->tag.c_str(), " ", "LOGIN", " ", email.c_str(), " ", password.c_str()))
                     return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
                     
+                imap_ctx->caps_cache.mechanism = imap_auth_cap_login;
                 setState(imap_state_auth_login);
             }
             else
@@ -219,10 +235,45 @@ namespace ReadyMailIMAP
             return true;
         }
 
+        // Skip the CAPABILITY command when the capabilities of server were cached.
+        // The cached capabilities are the capabilities after STARTTLS that do not include STARTTLS, they are only used
+        // when the connection is already encrypted (SSL connection or after STARTTLS) so that the STARTTLS of greeting is not skipped.
+        void checkCachedCap(imap_function_return_code &ret)
+        {
+            bool encrypted = imap_ctx->ssl_mode && (imap_ctx->server_status->secured || !imap_ctx->server_status->start_tls);
+            if (caps_cache.apply(imap_ctx, host, port, encrypted))
+            {
+#if defined(ENABLE_DEBUG)
+                setDebugState(imap_state_greeting, "Using the cached capabilities");
+#endif
+                serviceReady(ret);
+            }
+            else
+                checkCap();
+        }
+
+        void serviceReady(imap_function_return_code &ret)
+        {
+            imap_ctx->auth_caps[imap_auth_cap_login] = true;
+            cState() = imap_state_prompt;
+            if (imap_ctx->ssl_mode && imap_ctx->auth_caps[imap_auth_cap_starttls] && imap_ctx->server_status->start_tls && (tls_cb || imap_ctx->options.use_auto_client) && !imap_ctx->server_status->secured)
+                startTLS();
+            else
+            {
+                imap_ctx->server_status->server_greeting_ack = true;
+                tls_session.store();
+                exitState(ret, imap_ctx->options.processing);
+#if defined(ENABLE_DEBUG)
+                setDebugState(imap_state_greeting, "Service is ready\n");
+#endif
+            }
+        }
+
         void authenticate(imap_function_return_code &ret)
         {
             if (ret == function_return_failure && (cState() == imap_state_start_tls || cState() == imap_state_auth_login || cState() == imap_state_login_user || cState() == imap_state_login_psw || cState() == imap_state_auth_xoauth2 || cState() == imap_state_auth_plain || cState() == imap_state_id))
             {
+                caps_cache.invalidate(imap_ctx);
                 stop(true);
                 return;
             }
@@ -233,27 +284,14 @@ namespace ReadyMailIMAP
                 if (ret == function_return_continue && !imap_ctx->server_status->start_tls)
                     tlsHandshake();
                 else if (ret == function_return_success)
-                    checkCap();
+                    checkCachedCap(ret);
                 break;
 
             case imap_state_greeting:
                 if (ret == function_return_failure)
                     exitState(ret, imap_ctx->options.processing);
                 else if (ret == function_return_success)
-                {
-                    imap_ctx->auth_caps[imap_auth_cap_login] = true;
-                    cState() = imap_state_prompt;
-                    if (imap_ctx->ssl_mode && imap_ctx->auth_caps[imap_auth_cap_starttls] && imap_ctx->server_status->start_tls && (tls_cb || imap_ctx->options.use_auto_client) && !imap_ctx->server_status->secured)
-                        startTLS();
-                    else
-                    {
-                        imap_ctx->server_status->server_greeting_ack = true;
-                        exitState(ret, imap_ctx->options.processing);
-#if defined(ENABLE_DEBUG)
-                        setDebugState(imap_state_greeting, "Service is ready\n");
-#endif
-                    }
-                }
+                    serviceReady(ret);
                 break;
 
             case imap_state_start_tls:
@@ -262,7 +300,7 @@ namespace ReadyMailIMAP
                 break;
 
             case imap_state_start_tls_ack:
-                checkCap();
+                checkCachedCap(ret);
                 break;
 
             case imap_state_auth_login:
@@ -289,20 +327,68 @@ namespace ReadyMailIMAP
             case imap_state_id:
                 if (ret == function_return_success)
                 {
-                    imap_ctx->server_status->authenticated = true;
-                    exitState(ret, imap_ctx->options.processing);
-                    cState() = imap_state_prompt;
+#if defined(ENABLE_IMAP_COMPRESS)
+                    if (imap_ctx->options.compress && imap_ctx->feature_caps[imap_read_cap_compress_deflate] && !imap_ctx->deflate.isActive() && startCompress())
+                        break;
+#endif
+                    authenticated(ret);
+                }
+                break;
+
+#if defined(ENABLE_IMAP_COMPRESS)
+            case imap_state_compress:
+                // The session is still usable without compression when the server refused.
+                if (ret == function_return_success)
+                {
+                    imap_ctx->client = &imap_ctx->deflate;
 #if defined(ENABLE_DEBUG)
-                    setDebugState(imap_state_auth_plain, "The client is authenticated successfully\n");
+                    setDebugState(imap_state_compress, "The compression is enabled");
 #endif
                 }
+                else if (ret == function_return_failure)
+                    imap_ctx->deflate.end();
+
+                if (ret == function_return_success || ret == function_return_failure)
+                    authenticated(ret);
                 break;
+#endif
 
             default:
                 break;
             }
         }
 
+        void authenticated(imap_function_return_code &ret)
+        {
+            imap_ctx->server_status->authenticated = true;
+            caps_cache.store(imap_ctx, host, port);
+            // The session ticket may be received after the service is ready when no response was read after STARTTLS.
+            tls_session.store();
+            exitState(ret, imap_ctx->options.processing);
+            cState() = imap_state_prompt;
+#if defined(ENABLE_DEBUG)
+            setDebugState(imap_state_auth_plain, "The client is authenticated successfully\n");
+#endif
+        }
+
+#if defined(ENABLE_IMAP_COMPRESS)
+        bool startCompress()
+        {
+            // The memory is allocated before the request because the server data will be compressed right after the OK response.
+            // Continue without compression if it can't be allocated.
+            if (!imap_ctx->deflate.begin(imap_ctx->client, imap_ctx->options.compress_window_bits))
+                return false;
+#if defined(ENABLE_DEBUG)
+            setDebugState(imap_state_compress, "Starting compression...");
+#endif
+            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", "COMPRESS DEFLATE"))
+                return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+            setState(imap_state_compress);
+            return true;
+        }
+#endif
+
         void authLogin(bool user)
         {
             char *enc = rd_b64_enc(rd_cast<const unsigned char *>((user ? email.c_str() : password.c_str())), user ? email.length() : password.length());
@@ -341,6 +427,7 @@ namespace ReadyMailIMAP
 #if defined(ENABLE_DEBUG)
                 setDebugState(imap_state_start_tls, "Performing TLS handshake...");
 #endif
+                applyTLSSession();
 #if defined(ENABLE_READYCLIENT)
                 if (imap_ctx->auto_client && imap_ctx->options.use_auto_client)
                     imap_ctx->server_status->secured = imap_ctx->auto_client->connectSSL();
@@ -360,17 +447,41 @@ namespace ReadyMailIMAP
                 }
                 else
                 {
+                    tls_session.fail();
                     stop(true);
                     setError(imap_ctx, __func__, TCP_CLIENT_ERROR_TLS_HANDSHAKE);
                 }
             }
         }
 
+        ReadyTLSSessionCache *tlsSessionCache()
+        {
+#if defined(ENABLE_READYCLIENT)
+            if (!imap_ctx->tls_session_cache && imap_ctx->auto_client && imap_ctx->options.use_auto_client)
+                return imap_ctx->auto_client->getSessionCache();
+#endif
+            return imap_ctx->tls_session_cache;
+        }
+
+        // Apply the cached TLS session of server before the handshake, the session is stored when the service is ready.
+        // The session is only used for the SSL connection (SSL or STARTTLS), the plain connection has no session.
+        void applyTLSSession()
+        {
+            if (tls_session.apply(imap_ctx->ssl_mode ? tlsSessionCache() : nullptr, imap_ctx->client, host, port))
+            {
+#if defined(ENABLE_DEBUG)
+                setDebugState(imap_state_start_tls, "Resuming the TLS session...");
+#endif
+            }
+        }
+
     private:
         IMAPResponse *res = nullptr;
+        IMAPCapsCache caps_cache;
         TLSHandshakeCallback tls_cb = NULL;
         String host, email, password, access_token;
         bool has_credentials = false;
+        ReadyTLSSessionState tls_session;
         uint16_t port = 0;
         ReadyTimer conn_timer;
         bool authenticating = false;
@@ -0,0 +1,235 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The hash index, hierarchy tree and attributes of listed mailboxes.
+#ifndef IMAP_MAILBOX_DIR_H
+#define IMAP_MAILBOX_DIR_H
+#if defined(ENABLE_IMAP)
+#include <Arduino.h>
+#include "Common.h"
+
+namespace ReadyMailIMAP
+{
+    // The mailboxes list (attributes, delimiter and name) is kept as it is for compatibility,
+    // the directory context keeps the nodes and hashes of mailboxes in the same order.
+    class IMAPMailboxDir
+    {
+    public:
+        IMAPMailboxDir() {}
+        ~IMAPMailboxDir() {}
+
+        // Provides the index of mailbox in mailboxes list or -1 if it was not listed.
+        int find(imap_context *imap_ctx, const String &name)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            std::vector<std::array<String, 3>> &mailboxes = *imap_ctx->mailboxes;
+
+            // The mailboxes list was changed by user.
+            if (dir.nodes.size() != mailboxes.size())
+                rebuild(imap_ctx);
+
+            if (dir.table.size() == 0)
+                return -1;
+
+            uint32_t hash = getHash(name), mask = dir.table.size() - 1;
+            for (uint32_t i = hash & mask; dir.table[i] > -1; i = (i + 1) & mask)
+            {
+                int index = dir.table[i];
+                if (dir.hashes[index] == hash && mailboxes[index][2] == name)
+                    return index;
+            }
+            return -1;
+        }
+
+        IMAPMailboxNode node(imap_context *imap_ctx, int index)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            if (dir.nodes.size() != imap_ctx->mailboxes->size())
+                rebuild(imap_ctx);
+
+            IMAPMailboxNode root;
+            root.firstChild = dir.root;
+            return index > -1 && index < (int)dir.nodes.size() ? dir.nodes[index] : root;
+        }
+
+        // Start the LIST response update, the pattern is the LIST command mailbox pattern e.g. "*" or "Archive/%".
+        // The index is rebuilt as the mailboxes may be renamed or replaced in the list without changing its size.
+        void begin(imap_context *imap_ctx, const String &pattern)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            rebuild(imap_ctx);
+            dir.pattern = pattern;
+            dir.listed.assign(dir.nodes.size(), false);
+        }
+
+        // Add or update the listed mailbox.
+        void update(imap_context *imap_ctx, const std::array<String, 3> &buf)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            int index = find(imap_ctx, buf[2]);
+            if (index > -1)
+            {
+                (*imap_ctx->mailboxes)[index] = buf;
+                dir.nodes[index].attributes = getAttributes(buf[0]);
+                dir.listed[index] = true;
+                return;
+            }
+
+            imap_ctx->mailboxes->push_back(buf);
+            IMAPMailboxNode node;
+            node.attributes = getAttributes(buf[0]);
+            dir.nodes.push_back(node);
+            dir.hashes.push_back(getHash(buf[2]));
+            dir.listed.push_back(true);
+
+            if (dir.table.size() < dir.nodes.size() * 2)
+                buildTable(dir);
+            else
+                insert(dir, dir.nodes.size() - 1);
+        }
+
+        // Finish the LIST response update, the mailboxes that match the pattern but were not listed are removed.
+        void end(imap_context *imap_ctx)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            std::vector<std::array<String, 3>> &mailboxes = *imap_ctx->mailboxes;
+            size_t count = 0;
+            for (size_t i = 0; i < mailboxes.size(); i++)
+            {
+                if ((i < dir.listed.size() && dir.listed[i]) || !match(dir.pattern.c_str(), mailboxes[i][2].c_str(), getDelimiter(mailboxes[i])))
+                {
+                    if (count != i)
+                    {
+                        mailboxes[count] = mailboxes[i];
+                        dir.nodes[count] = dir.nodes[i];
+                        dir.hashes[count] = dir.hashes[i];
+                    }
+                    count++;
+                }
+            }
+
+            mailboxes.resize(count);
+            dir.nodes.resize(count);
+            dir.hashes.resize(count);
+            buildTable(dir);
+            dir.listed.clear();
+            buildTree(imap_ctx);
+        }
+
+    private:
+        void rebuild(imap_context *imap_ctx)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            std::vector<std::array<String, 3>> &mailboxes = *imap_ctx->mailboxes;
+            dir.nodes.assign(mailboxes.size(), IMAPMailboxNode());
+            dir.hashes.resize(mailboxes.size());
+            for (size_t i = 0; i < mailboxes.size(); i++)
+            {
+                dir.nodes[i].attributes = getAttributes(mailboxes[i][0]);
+                dir.hashes[i] = getHash(mailboxes[i][2]);
+            }
+            buildTable(dir);
+            buildTree(imap_ctx);
+        }
+
+        void buildTable(imap_mailbox_dir_ctx &dir)
+        {
+            size_t size = 16;
+            while (size < dir.nodes.size() * 2)
+                size *= 2;
+            dir.table.assign(size, -1);
+            for (size_t i = 0; i < dir.nodes.size(); i++)
+                insert(dir, i);
+        }
+
+        void insert(imap_mailbox_dir_ctx &dir, int index)
+        {
+            uint32_t mask = dir.table.size() - 1, i = dir.hashes[index] & mask;
+            while (dir.table[i] > -1)
+                i = (i + 1) & mask;
+            dir.table[i] = index;
+        }
+
+        // Link the mailboxes to their parent by the hierarchy delimiter, the children are in the list order.
+        void buildTree(imap_context *imap_ctx)
+        {
+            imap_mailbox_dir_ctx &dir = imap_ctx->mailbox_dir;
+            std::vector<std::array<String, 3>> &mailboxes = *imap_ctx->mailboxes;
+            dir.root = -1;
+            for (size_t i = 0; i < dir.nodes.size(); i++)
+                dir.nodes[i].parent = dir.nodes[i].firstChild = dir.nodes[i].nextSibling = -1;
+
+            for (int i = dir.nodes.size() - 1; i >= 0; i--)
+            {
+                char delim = getDelimiter(mailboxes[i]);
+                int p = delim ? mailboxes[i][2].lastIndexOf(delim) : -1;
+                int parent = p > 0 ? find(imap_ctx, mailboxes[i][2].substring(0, p)) : -1;
+                dir.nodes[i].parent = parent;
+                int &head = parent > -1 ? dir.nodes[parent].firstChild : dir.root;
+                dir.nodes[i].nextSibling = head;
+                head = i;
+            }
+        }
+
+        // The delimiter is "/", "." or NIL.
+        char getDelimiter(const std::array<String, 3> &mailbox)
+        {
+            const String &delim = mailbox[1];
+            if (delim.length() == 3 && delim[0] == '"')
+                return delim[1];
+            return delim.length() == 1 ? delim[0] : 0;
+        }
+
+        uint16_t getAttributes(const String &attrs)
+        {
+            static const char *names[] = {"\\noselect", "\\noinferiors", "\\haschildren", "\\hasnochildren", "\\marked", "\\unmarked", "\\nonexistent", "\\subscribed", "\\remote", "\\all", "\\archive", "\\drafts", "\\flagged", "\\junk", "\\sent", "\\trash"};
+            String s = attrs;
+            s.toLowerCase();
+            s += " ";
+            uint16_t bits = 0;
+            for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+            {
+                String name = names[i];
+                name += " ";
+                if (s.indexOf(name) > -1)
+                    bits |= 1 << i;
+            }
+            return bits;
+        }
+
+        // Match the mailbox name with LIST pattern, "*" matches any characters and "%" matches any characters except delimiter.
+        bool match(const char *pattern, const char *name, char delim)
+        {
+            if (*pattern == 0)
+                return *name == 0;
+            if (*pattern == '*' || *pattern == '%')
+            {
+                for (const char *p = name;; p++)
+                {
+                    if (match(pattern + 1, p, delim))
+                        return true;
+                    if (*p == 0 || (*pattern == '%' && *p == delim))
+                        return false;
+                }
+            }
+            return *pattern == *name && match(pattern + 1, name + 1, delim);
+        }
+
+        // FNV-1a hash of mailbox name.
+        uint32_t getHash(const String &name)
+        {
+            uint32_t hash = 2166136261UL;
+            for (size_t i = 0; i < name.length(); i++)
+            {
+                hash ^= (uint8_t)name[i];
+                hash *= 16777619UL;
+            }
+            return hash;
+        }
+    };
+}
+#endif
+#endif
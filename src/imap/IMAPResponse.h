@@ -23,6 +23,7 @@ namespace ReadyMailIMAP
         friend class IMAPConnection;
         friend class IMAPSend;
         friend class IMAPClient;
+        friend class IMAPSessionPool;
 
     public:
         void begin(imap_context *imap_ctx)
@@ -38,13 +39,56 @@ namespace ReadyMailIMAP
         {
             sys_yield();
             bool err = !serverConnected() || (!imap_ctx->options.idling && cState() != imap_state_idle && cState() != imap_state_done && readTimeout());
-            if (err || (!imap_ctx->options.searching && (cState() == imap_state_fetch_envelope || cState() == imap_state_fetch_body_part) && cMsg().files.size() && !cMsg().files[cFileIndex()].fetch))
+            if (err || (!imap_ctx->options.searching && cState() == imap_state_fetch_body_part && cFileIndex() < (int)cMsg().files.size() && !cMsg().files[cFileIndex()].fetch))
             {
                 cCode() = err ? function_return_failure : function_return_success;
                 return cCode();
             }
 
+#if defined(ENABLE_FS)
+            if (cState() == imap_state_fetch_envelope && cMsg().cached)
+            {
+                cMsg().cached = false;
+                cCode() = function_return_success;
+                return cCode();
+            }
+#endif
+
             cCode() = function_return_undefined;
+
+#if defined(ENABLE_IMAP_COMPRESS)
+            if (imap_ctx->deflate.failed())
+            {
+                stop(true);
+                setError(imap_ctx, __func__, IMAP_ERROR_COMPRESSION);
+                cCode() = function_return_failure;
+                return cCode();
+            }
+#endif
+
+            // The server response is not read until the part sinks accepted the pending data (backpressure).
+            if (cState() == imap_state_fetch_body_part && parser.flushSink(imap_ctx, cMsg()))
+            {
+                resp_timer.feed(imap_ctx->options.timeout.read / 1000);
+                return cCode();
+            }
+
+            // The rest of body part cannot be skipped without reading it, the connection is closed.
+            if (imap_ctx->options.sink_error)
+            {
+                imap_ctx->options.sink_error = false;
+                stop(true);
+                setError(imap_ctx, __func__, IMAP_ERROR_PART_SINK);
+                cCode() = function_return_failure;
+                return cCode();
+            }
+
+            if (cState() == imap_state_fetch_body_part && parser.binaryLiteral(cMsg()))
+            {
+                readBinary();
+                return cCode();
+            }
+
             if (!imap_ctx->options.multiline)
                 clear(line);
 
@@ -61,10 +105,26 @@ namespace ReadyMailIMAP
                 if (cType() == imap_response_ok)
                     cCode() = function_return_success;
 
-                if (cType() == imap_response_bad || cType() == imap_response_no)
+                // The rejected BINARY fetch is retried with BODY.
+                if ((cType() == imap_response_bad || cType() == imap_response_no) && cState() == imap_state_fetch_body_part && parser.rejectBinary(cMsg(), cFileIndex()))
+                {
+#if defined(ENABLE_DEBUG)
+                    setDebug(imap_ctx, "The BINARY fetch is rejected, fetching with BODY...\n");
+#endif
+                    cMsg().binary_retry = true;
+                    cCode() = function_return_success;
+                    return cCode();
+                }
+
+                // The rejected STATUS command of pipelined commands is handled in the imap_state_status.
+                if ((cType() == imap_response_bad || cType() == imap_response_no) && !(cState() == imap_state_status && imap_ctx->status_pending > 0))
                 {
                     cCode() = function_return_failure;
                     setError(imap_ctx, __func__, IMAP_ERROR_RESPONSE, imap_ctx->status->text);
+
+                    // The command may be rejected because of the outdated cached capabilities.
+                    if (cType() == imap_response_bad && imap_ctx->caps_cache.hit)
+                        imap_ctx->caps_cache.stale = true;
                 }
 
                 if ((cState() == imap_state_fetch_envelope || cState() == imap_state_fetch_body_part) && line.indexOf(imap_ctx->tag) == 0 && !cMsg().exists)
@@ -77,10 +137,12 @@ namespace ReadyMailIMAP
                 {
                 case imap_state_greeting:
                 case imap_state_auth_login:
+                case imap_state_login_psw:
                 case imap_state_auth_plain:
                 case imap_state_auth_xoauth2:
 
-                    if (line[0] == '*')
+                    // The capabilities may be changed after authentication e.g. ReadyMail OK [CAPABILITY IMAP4rev1 ... COMPRESS=DEFLATE] Logged in
+                    if (line[0] == '*' || line.indexOf("[CAPABILITY ") > -1)
                         parser.parseCaps(line, imap_ctx);
 
                     if (cState() == imap_state_auth_xoauth2 || cState() == imap_state_auth_plain)
@@ -110,25 +172,68 @@ namespace ReadyMailIMAP
                     break;
 
                 case imap_state_list:
-                    if (line[0] == '*')
+                    // LIST-STATUS returns the STATUS response after the LIST response of each mailbox.
+                    if (line.indexOf("* STATUS ") == 0)
+                        parser.parseStatus(line, imap_ctx);
+                    else if (line[0] == '*')
                     {
                         std::array<String, 3> buf;
                         parser.parseMailbox(line, buf);
                         if (buf[2].length())
-                            imap_ctx->mailboxes->push_back(buf);
+                            parser.mailbox_dir.update(imap_ctx, buf);
                     }
                     break;
 
                 case imap_state_examine:
                 case imap_state_select:
-                    if (line[0] == '*')
+                    // The changes that were reported with QRESYNC parameter.
+                    if (imap_ctx->options.syncing && parser.isSyncResponse(line))
+                        parser.parseSync(line, imap_ctx);
+                    else if (line[0] == '*' && !parser.isSyncResponse(line))
                         parser.parseExamine(line, mailbox_info, imap_ctx);
                     break;
 
+                case imap_state_sync:
+                    if (parser.isSyncResponse(line))
+                        parser.parseSync(line, imap_ctx);
+                    break;
+
                 case imap_state_search:
                     parser.parseSearch(line, imap_ctx, msgNumVec());
                     break;
 
+                case imap_state_sort:
+                    parser.parseSearch(line, imap_ctx, msgNumVec(), "* SORT");
+                    break;
+
+                case imap_state_thread:
+                    parser.parseThread(line, imap_ctx);
+                    break;
+
+                case imap_state_status:
+                    if (line.indexOf("* STATUS ") == 0)
+                        parser.parseStatus(line, imap_ctx);
+                    else if (cType() != imap_response_undefined && imap_ctx->status_pending > 0)
+                    {
+                        // The STATUS commands were pipelined, wait for all tagged responses.
+                        // The mailbox that cannot be accessed is reported as unavailable.
+                        size_t sent = imap_ctx->status_sent.size() - imap_ctx->status_pending;
+                        if ((cType() == imap_response_bad || cType() == imap_response_no) && sent < imap_ctx->status_sent.size())
+                        {
+                            IMAPMailboxStatus status;
+                            status.name = (*imap_ctx->mailboxes)[imap_ctx->status_sent[sent]][2];
+                            status.available = false;
+                            imap_ctx->mailbox_status->push_back(status);
+                        }
+                        imap_ctx->status_pending--;
+                        cCode() = imap_ctx->status_pending > 0 ? function_return_undefined : function_return_success;
+                    }
+                    break;
+
+                case imap_state_uid_map:
+                    parser.parseUIDSearch(line, imap_ctx);
+                    break;
+
                 case imap_state_fetch_envelope:
                 case imap_state_fetch_body_part:
                     parser.parseFetch(line, imap_ctx, cMsg(), cState(), cMsg().files[cFileIndex()]);
@@ -174,6 +279,10 @@ namespace ReadyMailIMAP
                 default:
                     break;
                 }
+
+                // The body part content lines are not the server responses.
+                if (cState() != imap_state_fetch_body_part)
+                    parser.trackUIDMap(line, imap_ctx);
             }
 
             if (cType() == imap_response_undefined && cState() == imap_state_initial_state)
@@ -245,8 +354,24 @@ namespace ReadyMailIMAP
             return p;
         }
 
+        // Read the BINARY literal octets in chunk instead of line.
+        void readBinary()
+        {
+            uint8_t buf[512];
+            int len = tcpAvailable();
+            if (len > (int)sizeof(buf))
+                len = sizeof(buf);
+            if (len > (int)cMsg().octet_remaining)
+                len = cMsg().octet_remaining;
+
+            len = len > 0 ? tcpRead(buf, len) : 0;
+            if (len > 0)
+                parser.parseBinaryLiteral(buf, len, imap_ctx, cMsg());
+        }
+
         int tcpAvailable() { return imap_ctx->client ? imap_ctx->client->available() : 0; }
         int tcpRead() { return imap_ctx->client ? imap_ctx->client->read() : -1; }
+        int tcpRead(uint8_t *buf, size_t len) { return imap_ctx->client ? imap_ctx->client->read(buf, len) : -1; }
         void stop(bool forceStop = false)
         {
             stopImpl(forceStop);
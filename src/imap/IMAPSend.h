@@ -85,8 +85,22 @@ namespace ReadyMailIMAP
 #if defined(ENABLE_DEBUG)
                 setDebug(imap_ctx, "The mailboxes are listed successfully\n");
 #endif
-                exitState(cCode(), imap_ctx->options.processing);
                 imap_ctx->options.mailboxes_updated = false;
+                res->parser.mailbox_dir.end(imap_ctx);
+                if (imap_ctx->options.list_status && !isListStatusSupported())
+                {
+                    imap_ctx->status_index = 0;
+                    sendStatus();
+                }
+                else
+                {
+                    imap_ctx->options.list_status = false;
+                    exitState(cCode(), imap_ctx->options.processing);
+                }
+                break;
+
+            case imap_state_status:
+                sendStatus();
                 break;
 
             case imap_state_examine:
@@ -94,9 +108,41 @@ namespace ReadyMailIMAP
 #if defined(ENABLE_DEBUG)
                 setDebug(imap_ctx, "The \"" + imap_ctx->current_mailbox + "\" is selected successfully\n");
 #endif
+                if (imap_ctx->options.syncing)
+                    syncChanges();
+                else
+                    exitState(cCode(), imap_ctx->options.processing);
+                break;
+
+            case imap_state_enable:
+                imap_ctx->qresync_enabled = true;
+                select(imap_ctx->sync_mailbox, imap_ctx->options.read_only_mode ? mailbox_mode_examine : mailbox_mode_select);
+                break;
+
+            case imap_state_sync:
+#if defined(ENABLE_DEBUG)
+                setDebug(imap_ctx, "The \"" + imap_ctx->current_mailbox + "\" is synchronized successfully\n");
+#endif
+                exitState(cCode(), imap_ctx->options.syncing);
+                exitState(cCode(), imap_ctx->options.processing);
+                break;
+
+            case imap_state_uid_map:
+#if defined(ENABLE_DEBUG)
+                setDebug(imap_ctx, "The UID map of \"" + imap_ctx->current_mailbox + "\" is updated successfully\n");
+#endif
+                res->parser.uid_map.assign(imap_ctx->uid_map);
                 exitState(cCode(), imap_ctx->options.processing);
                 break;
 
+            case imap_state_thread:
+#if defined(ENABLE_DEBUG)
+                setDebug(imap_ctx, "The \"" + imap_ctx->current_mailbox + "\" is threaded successfully\n");
+#endif
+                exitState(cCode(), imap_ctx->options.processing);
+                break;
+
+            case imap_state_sort:
             case imap_state_search:
 #if defined(ENABLE_DEBUG)
                 if (imap_ctx->cb_data.msgNums.size())
@@ -151,13 +197,44 @@ namespace ReadyMailIMAP
 
             case imap_state_fetch_body_part:
 
+                // The body parts that the BINARY fetch was rejected are fetched again with BODY.
+                if (cMsg().binary_retry)
+                {
+                    cMsg().binary_retry = false;
+                    sendFetch(imap_fetch_body_part);
+                    break;
+                }
+
+                // Fetch the next window of ranged fetch.
+                if (cMsg().octet_counting && !cMsg().multipart && cFileIndex() < (int)cMsg().files.size() && cMsg().files[cFileIndex()].window_pending)
+                {
+                    sendFetch(imap_fetch_body_part);
+                    break;
+                }
+
+                if (cMsg().multipart)
+                {
 #if defined(ENABLE_DEBUG)
-                if (cMsg().files[cFileIndex()].fetch)
-                    setDebug(imap_ctx, "The message body[" + cMsg().files[cFileIndex()].info.filename + "] is fetched successfully\n");
+                    for (size_t i = 0; i < cMsg().files.size(); i++)
+                    {
+                        if (cMsg().files[i].fetch)
+                            setDebug(imap_ctx, "The message body[" + cMsg().files[i].info.filename + "] is fetched successfully\n");
+                    }
 #endif
-                cFileIndex()++;
-                if (cMsg().fetch_count > 0)
-                    cMsg().fetch_count--;
+                    // All body parts were fetched in one command.
+                    cFileIndex() = cMsg().files.size();
+                    cMsg().fetch_count = 0;
+                }
+                else
+                {
+#if defined(ENABLE_DEBUG)
+                    if (cMsg().files[cFileIndex()].fetch)
+                        setDebug(imap_ctx, "The message body[" + cMsg().files[cFileIndex()].info.filename + "] is fetched successfully\n");
+#endif
+                    cFileIndex()++;
+                    if (cMsg().fetch_count > 0)
+                        cMsg().fetch_count--;
+                }
 
                 if (cFileIndex() == (int)cMsg().files.size() || (imap_ctx->options.searching && cMsg().fetch_count == 0))
                 {
@@ -215,6 +292,7 @@ namespace ReadyMailIMAP
 #endif
                 imap_ctx->options.mailbox_selected = false;
                 imap_ctx->current_mailbox.remove(0, imap_ctx->current_mailbox.length());
+                res->parser.uid_map.reset(imap_ctx->uid_map);
                 break;
 
             default:
@@ -244,6 +322,58 @@ namespace ReadyMailIMAP
             }
         }
 
+        // Request the flag changes since the stored modification sequence (CONDSTORE), the changes were already
+        // reported in SELECT/EXAMINE response when QRESYNC parameter was sent.
+        void syncChanges()
+        {
+            imap_sync_point &point = imap_ctx->sync_point;
+            MailboxInfo &info = res->mailbox_info;
+            bool valid = point.uidValidity > 0 && point.uidValidity == info.UIDValidity;
+
+            if (point.uidValidity > 0 && !valid && imap_ctx->cb.sync)
+            {
+                IMAPSyncData data;
+                data.event = imap_sync_event_invalidated;
+                imap_ctx->cb.sync(data);
+            }
+
+            if (valid && point.highestModseq > 0 && !imap_ctx->qresync_enabled && info.highestModseq != point.highestModseq)
+            {
+                String buf;
+                rd_print_to(buf, 100, " UID FETCH 1:* (FLAGS) (CHANGEDSINCE %llu)", (unsigned long long)point.highestModseq);
+                if (!tcpSend(true, 2, imap_ctx->tag.c_str(), buf.c_str()))
+                {
+                    setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+                    return;
+                }
+                setState(imap_state_sync);
+                return;
+            }
+
+            setState(imap_state_sync);
+            process();
+        }
+
+        bool sync(const String &mailbox, imap_mailbox_mode mode)
+        {
+            imap_ctx->options.syncing = true;
+            const imap_sync_point &point = imap_ctx->sync_point;
+
+            // QRESYNC should be enabled once in session before selecting the mailbox (RFC 7162 section 3.2.3).
+            if (imap_ctx->feature_caps[imap_read_cap_qresync] && imap_ctx->feature_caps[imap_read_cap_enable] && point.uidValidity > 0 && point.highestModseq > 0 && !imap_ctx->qresync_enabled)
+            {
+                imap_ctx->sync_mailbox = mailbox;
+                imap_ctx->options.read_only_mode = mode == mailbox_mode_examine;
+                setProcessFlag(imap_ctx->options.processing);
+                if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", "ENABLE QRESYNC"))
+                    return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+                setState(imap_state_enable);
+                return true;
+            }
+            return select(mailbox, mode);
+        }
+
         String getFetchString() { return imap_ctx->options.uid_fetch ? "UID" : "" + numString.get(imap_ctx->options.fetch_number); }
 
         bool sendFetch(imap_fetch_mode mode)
@@ -259,19 +389,81 @@ namespace ReadyMailIMAP
                 if (imap_ctx->options.searching)
                     setDebugState(state, "Fetching message " + getFetchString() + " envelope...");
 #endif
-                // Fetching full for ENVELOPE and BODY to count attachment.
-                rd_print_to(buf, 200, " %sFETCH %d FULL", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number);
+                // Fetching full (FLAGS INTERNALDATE RFC822.SIZE ENVELOPE BODY) for ENVELOPE and BODY to count attachment,
+                // and UID for resuming the body part fetch.
+                imap_ctx->cb_data.uidValidity = res->mailbox_info.UIDValidity;
+#if defined(ENABLE_FS)
+                // The envelope of UID that was already fetched is read from the cache without sending the command.
+                if (imap_ctx->options.uid_fetch && res->parser.readCachedEnvelope(imap_ctx, cMsg(), imap_ctx->options.fetch_number))
+                {
+                    setState(state);
+                    return true;
+                }
+#endif
+                rd_print_to(buf, 200, " %sFETCH %d (UID FLAGS INTERNALDATE RFC822.SIZE ENVELOPE BODY)", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number);
             }
             else if (mode == imap_fetch_body_part)
             {
                 state = imap_state_fetch_body_part;
+                cMsg().multipart = imap_ctx->options.multipart_fetch && imap_ctx->options.fetch_window == 0 && !imap_ctx->options.resume;
+                cMsg().octet_counting = false;
+                cMsg().octet_request = 0;
+                cMsg().octet_remaining = 0;
 
-                if (cFileIndex() < (int)cMsg().files.size() && cMsg().files[cFileIndex()].fetch)
+                if (cMsg().multipart)
                 {
+                    // Request all body parts that are set to fetch in one FETCH command.
+                    String items;
+                    while (cFileIndex() < (int)cMsg().files.size() && !cMsg().files[cFileIndex()].fetch)
+                        cFileIndex()++;
+
+                    for (int i = cFileIndex(); i < (int)cMsg().files.size(); i++)
+                    {
+                        if (cMsg().files[i].fetch)
+                        {
+                            cMsg().files[i].binary = binaryFetch(cMsg().files[i]);
+                            rd_print_to(items, cMsg().files[i].section.length() + 20, "%s%s%s[%s]", items.length() ? " " : "", cMsg().files[i].binary ? "BINARY" : "BODY", imap_ctx->options.read_only_mode ? ".PEEK" : "", cMsg().files[i].section.c_str());
+                        }
+                    }
+
+                    if (items.length())
+                    {
 #if defined(ENABLE_DEBUG)
-                    setDebugState(state, "Fetching message body[" + cMsg().files[cFileIndex()].info.filename + "]...");
+                        setDebugState(state, "Fetching message body parts...");
 #endif
-                    rd_print_to(buf, 200, " %sFETCH %d BODY%s[%s]", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number, imap_ctx->options.read_only_mode ? ".PEEK" : "", cMsg().files[cFileIndex()].section.c_str());
+                        cMsg().octet_counting = true;
+                        rd_print_to(buf, 200 + items.length(), " %sFETCH %d (%s)", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number, items.c_str());
+                    }
+                }
+                else if (cFileIndex() < (int)cMsg().files.size() && cMsg().files[cFileIndex()].fetch)
+                {
+                    imap_file_ctx &cfile = cMsg().files[cFileIndex()];
+                    if (!imap_ctx->options.resume)
+                        cfile.binary = binaryFetch(cfile);
+#if defined(ENABLE_DEBUG)
+                    if (!cfile.window_pending)
+                        setDebugState(state, "Fetching message body[" + cfile.info.filename + "]...");
+#endif
+                    if (imap_ctx->options.fetch_window > 0 || cfile.offset > 0)
+                    {
+                        // Ranged fetch from the received octets offset. Without the fetch window (resuming),
+                        // the remaining octets plus one is requested for the end of body part to be detected in one window.
+                        cMsg().octet_counting = true;
+                        cMsg().octet_request = imap_ctx->options.fetch_window;
+                        if (cMsg().octet_request == 0)
+                        {
+                            uint32_t size = cfile.binary ? cfile.info.fileSize : cfile.octet_count;
+                            cMsg().octet_request = size > cfile.offset ? size - cfile.offset + 1 : 4096;
+                        }
+
+                        rd_print_to(buf, 200, " %sFETCH %d %s%s[%s]<%d.%d>", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number, cfile.binary ? "BINARY" : "BODY", imap_ctx->options.read_only_mode ? ".PEEK" : "", cfile.section.c_str(), cfile.offset, cMsg().octet_request);
+                    }
+                    else
+                    {
+                        // The BINARY literal can't be parsed line by line.
+                        cMsg().octet_counting = cfile.binary;
+                        rd_print_to(buf, 200, " %sFETCH %d %s%s[%s]", imap_ctx->options.uid_fetch ? "UID " : "", imap_ctx->options.fetch_number, cfile.binary ? "BINARY" : "BODY", imap_ctx->options.read_only_mode ? ".PEEK" : "", cfile.section.c_str());
+                    }
                 }
             }
 
@@ -346,18 +538,84 @@ namespace ReadyMailIMAP
             cCode() = function_return_undefined;
         }
 
-        bool list()
+        // The listed mailboxes are updated in place, the mailboxes that match the pattern but no longer exist are removed.
+        bool list(const String &pattern = "*")
         {
-            imap_ctx->mailboxes->clear();
-            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", "LIST \"\" *"))
+            String buf;
+            res->parser.mailbox_dir.begin(imap_ctx, pattern);
+            rd_print_to(buf, 20 + pattern.length(), "LIST \"\" \"%s\"", pattern.c_str());
+            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", buf.c_str()))
                 return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
 
             setState(imap_state_list);
             return true;
         }
 
+        bool isListStatusSupported() { return imap_ctx->feature_caps[imap_read_cap_list_status]; }
+
+        // List the mailboxes with their status, LIST-STATUS is used when it is supported
+        // otherwise the STATUS of listed mailboxes are requested.
+        bool listStatus()
+        {
+            imap_ctx->mailbox_status->clear();
+            imap_ctx->options.list_status = true;
+            setProcessFlag(imap_ctx->options.processing);
+
+            if (isListStatusSupported())
+            {
+                res->parser.mailbox_dir.begin(imap_ctx, "*");
+                if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", "LIST \"\" * RETURN (STATUS (MESSAGES UNSEEN UIDNEXT))"))
+                    return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+                setState(imap_state_list);
+                return true;
+            }
+
+            if (imap_ctx->mailboxes->size() == 0 || imap_ctx->options.mailboxes_updated)
+                return list();
+
+            imap_ctx->status_index = 0;
+            return sendStatus();
+        }
+
+        // Send the STATUS commands of next mailboxes at once, the process is done when no mailbox left.
+        bool sendStatus()
+        {
+            String buf;
+            imap_ctx->status_pending = 0;
+            imap_ctx->status_sent.clear();
+            while (imap_ctx->status_index < imap_ctx->mailboxes->size() && imap_ctx->status_pending < IMAP_STATUS_PIPELINE_SIZE)
+            {
+                int index = imap_ctx->status_index++;
+                const std::array<String, 3> &mailbox = (*imap_ctx->mailboxes)[index];
+                if (res->parser.mailbox_dir.node(imap_ctx, index).attributes & (imap_mailbox_attr_noselect | imap_mailbox_attr_nonexistent))
+                    continue;
+                rd_print_to(buf, 100 + mailbox[2].length(), "%s STATUS \"%s\" (MESSAGES UNSEEN UIDNEXT)\r\n", imap_ctx->tag.c_str(), mailbox[2].c_str());
+                imap_ctx->status_pending++;
+                imap_ctx->status_sent.push_back(index);
+            }
+
+            if (imap_ctx->status_pending == 0)
+            {
+#if defined(ENABLE_DEBUG)
+                setDebug(imap_ctx, "The mailboxes status are listed successfully\n");
+#endif
+                imap_ctx->options.list_status = false;
+                exitState(cCode(), imap_ctx->options.processing);
+                return true;
+            }
+
+            if (!tcpSend(false, 1, buf.c_str()))
+                return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+            setState(imap_state_status);
+            return true;
+        }
+
         bool isCondStoreSupported() { return imap_ctx->feature_caps[imap_read_cap_condstore]; }
 
+        // The non-text body part is fetched with BINARY when it was enabled and supported.
+        bool binaryFetch(const imap_file_ctx &cfile) { return imap_ctx->options.binary_fetch && imap_ctx->feature_caps[imap_read_cap_binary] && !cfile.text_part && !cfile.binary_rejected; }
+
         bool select(const String &mailbox, imap_mailbox_mode mode)
         {
             bool exists = false;
@@ -367,23 +625,14 @@ namespace ReadyMailIMAP
             // mailbox name should not close for re-selection otherwise the server returned * BAD Command Argument Error. 12
 
             // guards 3 seconds to prevent accidently frequently select the same mailbox with the same mode
-            if (!imap_ctx->options.mailbox_selected && imap_ctx->current_mailbox == mailbox && millis() - imap_ctx->options.timeout.mailbox_selected < 3000)
+            if (!imap_ctx->options.syncing && !imap_ctx->options.mailbox_selected && imap_ctx->current_mailbox == mailbox && millis() - imap_ctx->options.timeout.mailbox_selected < 3000)
             {
                 if ((imap_ctx->options.read_only_mode && mode == mailbox_mode_examine) || (!imap_ctx->options.read_only_mode && mode == mailbox_mode_select))
                     return true;
             }
 
-            if (mailbox.length() > 0)
-            {
-                for (int i = 0; i < (int)imap_ctx->mailboxes->size(); i++)
-                {
-                    if (mailbox == (*imap_ctx->mailboxes)[i][2])
-                    {
-                        exists = true;
-                        imap_ctx->current_mailbox = mailbox;
-                    }
-                }
-            }
+            if (mailbox.length() > 0 && res->parser.mailbox_dir.find(imap_ctx, mailbox) > -1)
+                exists = true;
 
             if (!exists && imap_ctx->mailboxes->size()) // Skip mailbox checking if list is not executed.
                 return setError(imap_ctx, __func__, IMAP_ERROR_MAILBOX_NOT_EXISTS);
@@ -395,8 +644,13 @@ namespace ReadyMailIMAP
             setProcessFlag(imap_ctx->options.processing);
             clearMailboxInfo();
 
-            String buf;
-            rd_print_to(buf, 120, " \"%s\"%s", mailbox.c_str(), isCondStoreSupported() ? " (CONDSTORE)" : "");
+            String buf, param;
+            const imap_sync_point &point = imap_ctx->sync_point;
+            if (imap_ctx->options.syncing && imap_ctx->qresync_enabled && point.uidValidity > 0 && point.highestModseq > 0)
+                rd_print_to(param, 100 + point.knownUIDs.length(), " (QRESYNC (%u %llu%s%s))", point.uidValidity, (unsigned long long)point.highestModseq, point.knownUIDs.length() ? " " : "", point.knownUIDs.c_str());
+            else if (isCondStoreSupported())
+                param = " (CONDSTORE)";
+            rd_print_to(buf, 120 + param.length(), " \"%s\"%s", mailbox.c_str(), param.c_str());
             if (!tcpSend(true, 4, imap_ctx->tag.c_str(), " ", mode == mailbox_mode_examine ? "EXAMINE" : "SELECT", buf.c_str()))
                 return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
 
@@ -430,6 +684,77 @@ namespace ReadyMailIMAP
             setState(imap_state_search);
             return true;
         }
+        // The server sorts the messages that match the search keys, only the first search_limit messages are kept.
+        bool sort(const std::vector<IMAPSortCriterion> &criteria, const String &searchKeys, bool uid)
+        {
+            static const char *keys[] = {"ARRIVAL", "CC", "DATE", "FROM", "SIZE", "SUBJECT", "TO"};
+            String buf = uid ? "UID SORT (" : "SORT (";
+            for (size_t i = 0; i < criteria.size(); i++)
+            {
+                if (i > 0)
+                    buf += " ";
+                if (criteria[i].reverse)
+                    buf += "REVERSE ";
+                buf += keys[criteria[i].key];
+            }
+            buf += ") UTF-8 ";
+            buf += searchKeys;
+
+            msgNumVec().clear();
+            imap_ctx->options.uid_search = uid;
+            imap_ctx->options.recent_sort = false;
+            imap_ctx->cb_data.msgFound = 0;
+
+            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", buf.c_str()))
+                return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+            setProcessFlag(imap_ctx->options.searching);
+            setState(imap_state_sort);
+            return true;
+        }
+
+        bool thread(imap_thread_algorithm algorithm, const String &searchKeys, bool uid)
+        {
+            String buf;
+            rd_print_to(buf, 50 + searchKeys.length(), "%sTHREAD %s UTF-8 %s", uid ? "UID " : "", algorithm == imap_thread_references ? "REFERENCES" : "ORDEREDSUBJECT", searchKeys.c_str());
+
+            imap_thread_ctx &thread = imap_ctx->thread;
+            thread.nodes.clear();
+            thread.tails.clear();
+            thread.stack.clear();
+            thread.parent = thread.last = thread.root_tail = -1;
+
+            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", buf.c_str()))
+                return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+            setProcessFlag(imap_ctx->options.processing);
+            setState(imap_state_thread);
+            return true;
+        }
+
+        // Search the UIDs of all messages or the messages that their UIDs are not yet known.
+        bool updateUIDMap()
+        {
+            imap_uid_map_ctx &map = imap_ctx->uid_map;
+            map.results.clear();
+            map.search_start = res->parser.uid_map.firstUnknown(map);
+
+            String buf = "UID SEARCH ";
+            if (imap_ctx->feature_caps[imap_read_cap_esearch])
+                buf += "RETURN (ALL) ";
+            if (map.search_start > 1)
+                rd_print_to(buf, 20, "%u:*", map.search_start);
+            else
+                buf += "ALL";
+
+            setProcessFlag(imap_ctx->options.processing);
+            if (!tcpSend(true, 3, imap_ctx->tag.c_str(), " ", buf.c_str()))
+                return setError(imap_ctx, __func__, TCP_CLIENT_ERROR_SEND_DATA);
+
+            setState(imap_state_uid_map);
+            return true;
+        }
+
 #if defined(ENABLE_IMAP_APPEND)
         bool append(const SMTPMessage &msg, const String &flags, const String &date, bool lastAppend)
         {
@@ -484,7 +809,14 @@ namespace ReadyMailIMAP
             res->mailbox_info.flags.clear();
             res->mailbox_info.permanentFlags.clear();
             res->mailbox_info.msgCount = 0;
+            res->mailbox_info.UIDValidity = 0;
+            res->mailbox_info.highestModseq = 0;
+            res->mailbox_info.noModseq = false;
             imap_ctx->cb_data.msgFound = 0;
+            // The message numbers of queued IDLE events and UID map belong to the previous mailbox.
+            imap_ctx->idle_queue.head = 0;
+            imap_ctx->idle_queue.count = 0;
+            res->parser.uid_map.reset(imap_ctx->uid_map);
         }
     };
 }
@@ -0,0 +1,363 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The pool of IMAP sessions (connections) that are driven by a single non-blocking loop.
+#ifndef IMAP_SESSION_POOL_H
+#define IMAP_SESSION_POOL_H
+#if defined(ENABLE_IMAP)
+#include <Arduino.h>
+#include "Common.h"
+#include "IMAPClient.h"
+
+#define DEFAULT_SESSION_RETRY_INTERVAL 10 * 1000
+#define DEFAULT_SESSION_TASK_ATTEMPTS 3
+
+namespace ReadyMailIMAP
+{
+    enum imap_session_task_type
+    {
+        imap_session_task_none,
+        imap_session_task_fetch,
+        imap_session_task_fetch_uid,
+        imap_session_task_search
+    };
+
+    // The task that is started when the session is ready.
+    struct imap_session_task
+    {
+        imap_session_task_type type = imap_session_task_none;
+        uint32_t number = 0, limit = 0;
+        bool recent_sort = true;
+        String criteria, download_folder;
+        IMAPDataCallback data_cb = NULL;
+        FileCallback file_cb = NULL;
+        // The number of failed starts, the task is retried after the retry interval.
+        uint8_t attempts = 0;
+    };
+
+    struct imap_session_ctx
+    {
+        IMAPClient *client = nullptr;
+        String mailbox;
+        bool read_only = true, idling = true;
+        imap_session_task task;
+        // The error code of the last task that could not be started.
+        int task_error = 0;
+        // The last connecting, authenticating or selecting state and its time for retry interval.
+        imap_state step = imap_state_prompt;
+        unsigned long step_ms = 0;
+    };
+
+    // Each session owns one network client and is assigned to one mailbox. The sessions are connected,
+    // authenticated, selected and idled in async mode, the fetch and search tasks are started when the
+    // session is ready (the idling is stopped first), so that one session never blocks the others.
+    class IMAPSessionPool
+    {
+    public:
+        IMAPSessionPool() {}
+        // The sessions own their IMAPClient objects.
+        IMAPSessionPool(const IMAPSessionPool &) = delete;
+        IMAPSessionPool &operator=(const IMAPSessionPool &) = delete;
+        ~IMAPSessionPool()
+        {
+            for (size_t i = 0; i < sessions.size(); i++)
+                delete sessions[i].client;
+            sessions.clear();
+        }
+
+        /** Set the server and credentials of all sessions.
+         *
+         * @param host The IMAP server host name.
+         * @param port The IMAP server port.
+         * @param email The user Email to authenticate.
+         * @param param The user password or access token.
+         * @param auth The readymail_auth_type enum i.e. readymail_auth_password, readymail_auth_accesstoken and readymail_auth_disabled.
+         * @param ssl Optional. The boolean option to connect in SSL mode.
+         * @param responseCallback Optional. The IMAPResponseCallback callback function that provides the processing status of all sessions.
+         */
+        void begin(const String &host, uint16_t port, const String &email, const String &param, readymail_auth_type auth = readymail_auth_password, bool ssl = true, IMAPResponseCallback responseCallback = NULL)
+        {
+            this->host = host;
+            this->port = port;
+            this->email = email;
+            this->param = param;
+            this->auth = auth;
+            this->ssl = ssl;
+            resp_cb = responseCallback;
+        }
+
+        /** Add the session that is assigned to mailbox.
+         *
+         * @param client The Arduino client e.g. network client or SSL client that is used by this session only.
+         * @param mailbox The name of folder/mailbox to select.
+         * @param readOnly Optional. The boolean option for selecting the mailbox in read only mode.
+         * @param idling Optional. The boolean option to idle the mailbox while no task is running.
+         * @return index of session.
+         */
+        int addSession(Client &client, const String &mailbox, bool readOnly = true, bool idling = true)
+        {
+            imap_session_ctx session;
+            session.client = new IMAPClient(client);
+            session.mailbox = mailbox;
+            session.read_only = readOnly;
+            session.idling = idling;
+            sessions.push_back(session);
+            return sessions.size() - 1;
+        }
+
+        /** Provides the number of sessions.
+         *
+         * @return number of sessions.
+         */
+        int sessionCount() { return sessions.size(); }
+
+        /** Provides the index of session that is assigned to mailbox.
+         *
+         * @param mailbox The name of folder/mailbox.
+         * @return index of session or -1 if not found.
+         */
+        int find(const String &mailbox)
+        {
+            for (size_t i = 0; i < sessions.size(); i++)
+            {
+                if (sessions[i].mailbox == mailbox)
+                    return i;
+            }
+            return -1;
+        }
+
+        /** Provides the IMAPClient of session e.g. for checking the idle events and mailbox info.
+         *
+         * @param index The index of session.
+         * @return IMAPClient class object.
+         * The blocking (await) functions of this IMAPClient should not be called.
+         */
+        IMAPClient &session(int index) { return *sessions[index].client; }
+
+        /** Provides the ready status of session.
+         *
+         * @param index The index of session.
+         * @return boolean status of session that the mailbox was selected and no task is running or waiting.
+         */
+        bool isReady(int index)
+        {
+            if (!isValid(index))
+                return false;
+            imap_session_ctx &s = sessions[index];
+            return s.task.type == imap_session_task_none && !isBusy(*s.client) && isSelected(s);
+        }
+
+        /** Fetch the message in the mailbox of session.
+         *
+         * @param index The index of session.
+         * @param number The message number or UID when uidFetch is true.
+         * @param dataCallback The IMAPDataCallback callback function that provides the instant information of processing state.
+         * @param fileCallback Optional. The FileCallback callback function for file/attachment download.
+         * @param uidFetch Optional. The boolean option to fetch the message by UID.
+         * @param bodySizeLimit The maximum size of body part content that can be download or stream in bytes.
+         * @param downloadFolder The name of folder that stores the downloaded files.
+         * @return boolean status of task adding. It returns false when the previous task of session was not started.
+         */
+        bool fetch(int index, uint32_t number, IMAPDataCallback dataCallback, FileCallback fileCallback = NULL, bool uidFetch = false, uint32_t bodySizeLimit = 5 * 1024 * 1024, const String &downloadFolder = "")
+        {
+            if (!isValid(index) || sessions[index].task.type != imap_session_task_none)
+                return false;
+            imap_session_task &task = sessions[index].task;
+            task = imap_session_task();
+            sessions[index].task_error = 0;
+            task.type = uidFetch ? imap_session_task_fetch_uid : imap_session_task_fetch;
+            task.number = number;
+            task.limit = bodySizeLimit;
+            task.data_cb = dataCallback;
+            task.file_cb = fileCallback;
+            task.download_folder = downloadFolder;
+            return true;
+        }
+
+        /** Search the mailbox of session.
+         *
+         * @param index The index of session.
+         * @param criteria The search criteria, see IMAPClient::search().
+         * @param searchLimit The maximum number of message (number or UID) that can store in the message list.
+         * @param recentSort The boolean option for recent sort order.
+         * @param dataCallback The IMAPDataCallback callback function that provides the instant information of processing state.
+         * @return boolean status of task adding. It returns false when the previous task of session was not started.
+         */
+        bool search(int index, const String &criteria, uint32_t searchLimit, bool recentSort, IMAPDataCallback dataCallback)
+        {
+            if (!isValid(index) || sessions[index].task.type != imap_session_task_none)
+                return false;
+            imap_session_task &task = sessions[index].task;
+            task = imap_session_task();
+            sessions[index].task_error = 0;
+            task.type = imap_session_task_search;
+            task.criteria = criteria;
+            task.limit = searchLimit;
+            task.recent_sort = recentSort;
+            task.data_cb = dataCallback;
+            return true;
+        }
+
+        /** Provides the error of the last task of session that could not be started.
+         *
+         * @param index The index of session.
+         * @return error code of the task that was removed after it could not be started, or 0 if no error.
+         * The task is retried after the retry interval when it could not be started (see setRetryInterval() and setTaskAttempts()),
+         * the error is cleared when the next task is added.
+         */
+        int taskError(int index) { return isValid(index) ? sessions[index].task_error : 0; }
+
+        /** Set the interval to retry the connecting, authenticating, selecting and task starting after failure.
+         *
+         * @param interval The retry interval in milliseconds. The default is 10 seconds.
+         */
+        void setRetryInterval(uint32_t interval) { retry_interval = interval; }
+
+        /** Set the maximum number of attempts to start the task.
+         *
+         * @param attempts The number of attempts. The default is 3.
+         */
+        void setTaskAttempts(uint8_t attempts) { task_attempts = attempts > 0 ? attempts : 1; }
+
+        /** Perform the async processes of all sessions.
+         * This should be called in the loop, each session is served once per call in round-robin order.
+         */
+        void loop()
+        {
+            size_t n = sessions.size();
+            for (size_t i = 0; i < n; i++)
+                run(sessions[(rr + i) % n]);
+            if (n > 0)
+                rr = (rr + 1) % n;
+        }
+
+        /** Stop all sessions.
+         */
+        void stop()
+        {
+            for (size_t i = 0; i < sessions.size(); i++)
+            {
+                sessions[i].client->stop();
+                sessions[i].task.type = imap_session_task_none;
+                sessions[i].step = imap_state_prompt;
+            }
+        }
+
+    private:
+        std::vector<imap_session_ctx> sessions;
+        String host, email, param;
+        uint16_t port = 993;
+        readymail_auth_type auth = readymail_auth_password;
+        bool ssl = true;
+        IMAPResponseCallback resp_cb = NULL;
+        uint32_t retry_interval = DEFAULT_SESSION_RETRY_INTERVAL;
+        uint8_t task_attempts = DEFAULT_SESSION_TASK_ATTEMPTS;
+        size_t rr = 0;
+
+        bool isValid(int index) { return index > -1 && index < (int)sessions.size(); }
+
+        // The search sets its own process flag instead of the processing flag.
+        bool isBusy(IMAPClient &c) { return c.isProcessing() || c.imap_ctx.options.searching; }
+
+        bool isSelected(imap_session_ctx &s)
+        {
+            IMAPClient &c = *s.client;
+            return c.isAuthenticated() && c.imap_ctx.current_mailbox == s.mailbox && c.res.mailbox_info.name == s.mailbox && c.res.mailbox_info.UIDValidity > 0;
+        }
+
+        // The same setup step that was started previously was failed, wait for retry interval.
+        bool beginStep(imap_session_ctx &s, imap_state step)
+        {
+            if (s.step == step && millis() - s.step_ms < retry_interval)
+                return false;
+            s.step = step;
+            s.step_ms = millis();
+            return true;
+        }
+
+        void run(imap_session_ctx &s)
+        {
+            IMAPClient &c = *s.client;
+            bool selected = isSelected(s);
+            c.loop(s.idling && selected && s.task.type == imap_session_task_none && !isBusy(c));
+
+            if (isBusy(c))
+                return;
+
+            if (!c.isConnected())
+            {
+                if (beginStep(s, imap_state_initial_state))
+                    c.connect(host, port, resp_cb, ssl, false);
+            }
+            else if (auth != readymail_auth_disabled && !c.isAuthenticated())
+            {
+                if (beginStep(s, imap_state_authentication))
+                    c.authenticate(email, param, auth, false);
+            }
+            else if (!selected)
+            {
+                if (c.imap_ctx.options.idling)
+                    c.sendDone(false);
+                else if (beginStep(s, imap_state_select))
+                    c.select(s.mailbox, s.read_only, false);
+            }
+            else if (s.task.type != imap_session_task_none)
+            {
+                if (c.imap_ctx.options.idling)
+                    c.sendDone(false);
+                else if (s.task.attempts == 0 || beginStep(s, imap_state_fetch_envelope))
+                    startTask(s);
+            }
+        }
+
+        // The task that could not be started is kept for retry, it is removed and its error is kept for taskError()
+        // when the attempts were exhausted or the error is not recoverable e.g. invalid search criteria.
+        void startTask(imap_session_ctx &s)
+        {
+            IMAPClient &c = *s.client;
+            imap_session_task &task = s.task;
+            bool ret = false;
+            s.step = imap_state_fetch_envelope;
+            s.step_ms = millis();
+            c.imap_ctx.status->errorCode = 0;
+            switch (task.type)
+            {
+            case imap_session_task_fetch:
+            case imap_session_task_fetch_uid:
+                if (task.type == imap_session_task_fetch_uid)
+                    ret = c.fetchUID(task.number, task.data_cb, task.file_cb, false, task.limit, task.download_folder);
+                else
+                    ret = c.fetch(task.number, task.data_cb, task.file_cb, false, task.limit, task.download_folder);
+                break;
+
+            case imap_session_task_search:
+                ret = c.search(task.criteria, task.limit, task.recent_sort, task.data_cb, false);
+                break;
+
+            default:
+                break;
+            }
+
+            if (ret)
+            {
+                s.step = imap_state_prompt;
+                task.type = imap_session_task_none;
+                return;
+            }
+
+            int code = c.imap_ctx.status->errorCode;
+            bool fatal = code == IMAP_ERROR_INVALID_SEARCH_CRITERIA || code == IMAP_ERROR_MODSEQ_WAS_NOT_SUPPORTED || code == IMAP_ERROR_NO_CALLBACK || code == IMAP_ERROR_MESSAGE_NOT_EXISTS;
+            if (fatal || ++task.attempts >= task_attempts)
+            {
+                s.step = imap_state_prompt;
+                s.task_error = code ? code : IMAP_ERROR_PROCESSING;
+                task.type = imap_session_task_none;
+            }
+        }
+    };
+}
+#endif
+#endif
@@ -0,0 +1,233 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Suwatchai K. <suwatchai@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// The message number to UID map of selected mailbox that is updated from EXPUNGE, VANISHED and EXISTS responses.
+#ifndef IMAP_UID_MAP_H
+#define IMAP_UID_MAP_H
+#if defined(ENABLE_IMAP)
+#include <Arduino.h>
+#include "Common.h"
+
+namespace ReadyMailIMAP
+{
+    // The expunged messages are not removed from the UID list but from the Fenwick tree of existing messages,
+    // the message number is the rank of existing message which is looked up in O(log n).
+    class IMAPUIDMap
+    {
+    public:
+        IMAPUIDMap() {}
+        ~IMAPUIDMap() {}
+
+        bool isBuilt(const imap_uid_map_ctx &map) { return map.built; }
+
+        void reset(imap_uid_map_ctx &map)
+        {
+            map.uids.clear();
+            map.tree.clear();
+            map.results.clear();
+            map.count = 0;
+            map.known = 0;
+            map.search_start = 0;
+            map.built = false;
+        }
+
+        // Apply the UIDs from the search result, the whole map is rebuilt when the search was started from the first message.
+        void assign(imap_uid_map_ctx &map)
+        {
+            std::sort(map.results.begin(), map.results.end());
+            if (!map.built || map.search_start <= 1)
+            {
+                map.uids = map.results;
+                build(map);
+                map.built = true;
+            }
+            else
+            {
+                for (size_t i = 0; i < map.results.size() && map.search_start + i <= map.count; i++)
+                {
+                    uint32_t pos = find(map, map.search_start + i);
+                    if (map.uids[pos - 1] == 0)
+                        map.uids[pos - 1] = map.results[i];
+                }
+                updateKnown(map);
+            }
+            map.results.clear();
+        }
+
+        // Provides the UID of message number or 0 if it is unknown.
+        uint32_t uid(imap_uid_map_ctx &map, uint32_t msgNum)
+        {
+            if (!map.built || msgNum == 0 || msgNum > map.count)
+                return 0;
+            return map.uids[find(map, msgNum) - 1];
+        }
+
+        // Provides the message number of UID or 0 if it is unknown or was expunged.
+        uint32_t msgNum(imap_uid_map_ctx &map, uint32_t uid)
+        {
+            int i = indexOf(map, uid);
+            return i > -1 ? prefix(map, i + 1) : 0;
+        }
+
+        // Provides the first message number that its UID is unknown or 0 if all UIDs are known.
+        uint32_t firstUnknown(imap_uid_map_ctx &map)
+        {
+            uint32_t n = prefix(map, map.known);
+            return map.built && n < map.count ? n + 1 : 0;
+        }
+
+        // The mailbox message count was reported (* n EXISTS), the new messages are added with unknown UIDs.
+        void exists(imap_uid_map_ctx &map, uint32_t total)
+        {
+            while (map.built && map.count < total)
+                append(map, 0);
+        }
+
+        // The message was removed (* n EXPUNGE), returns its UID.
+        uint32_t expunge(imap_uid_map_ctx &map, uint32_t msgNum)
+        {
+            if (!map.built || msgNum == 0 || msgNum > map.count)
+                return 0;
+            uint32_t pos = find(map, msgNum), uid = map.uids[pos - 1];
+            remove(map, pos);
+            compact(map);
+            return uid;
+        }
+
+        // The messages in UID range were removed (* VANISHED first:last).
+        void vanish(imap_uid_map_ctx &map, uint32_t first, uint32_t last)
+        {
+            if (!map.built)
+                return;
+            uint32_t i = std::lower_bound(map.uids.begin(), map.uids.begin() + map.known, first) - map.uids.begin();
+            for (; i < map.known && map.uids[i] <= last; i++)
+            {
+                if (isExisting(map, i + 1))
+                    remove(map, i + 1);
+            }
+            compact(map);
+        }
+
+        // The UID of message was reported (* n FETCH (UID uid ...)), only the next unknown UID is updated to keep the order.
+        void setUID(imap_uid_map_ctx &map, uint32_t msgNum, uint32_t uid)
+        {
+            if (!map.built || msgNum == 0 || msgNum > map.count || uid == 0)
+                return;
+            uint32_t pos = find(map, msgNum);
+            if (map.uids[pos - 1] == 0 && msgNum == firstUnknown(map) && (map.known == 0 || map.uids[map.known - 1] < uid))
+            {
+                map.uids[pos - 1] = uid;
+                updateKnown(map);
+            }
+        }
+
+    private:
+        void build(imap_uid_map_ctx &map)
+        {
+            // All messages exist, the node i covers lowbit(i) messages.
+            uint32_t n = map.uids.size();
+            map.tree.assign(n + 1, 0);
+            for (uint32_t i = 1; i <= n; i++)
+                map.tree[i] = i & (~i + 1);
+            map.count = n;
+            map.known = 0;
+            updateKnown(map);
+        }
+
+        void append(imap_uid_map_ctx &map, uint32_t uid)
+        {
+            if (map.tree.size() == 0)
+                map.tree.push_back(0);
+            map.uids.push_back(uid);
+            uint32_t n = map.uids.size();
+            map.tree.push_back(prefix(map, n - 1) - prefix(map, n - (n & (~n + 1))) + 1);
+            map.count++;
+        }
+
+        void remove(imap_uid_map_ctx &map, uint32_t pos)
+        {
+            for (uint32_t i = pos; i < map.tree.size(); i += i & (~i + 1))
+                map.tree[i]--;
+            map.count--;
+        }
+
+        // Remove the expunged messages from the UID list when they are more than the existing messages.
+        void compact(imap_uid_map_ctx &map)
+        {
+            if (map.uids.size() <= 2 * map.count + 32)
+                return;
+
+            std::vector<uint32_t> uids;
+            uids.reserve(map.count);
+            for (uint32_t i = 0; i < map.uids.size(); i++)
+            {
+                if (isExisting(map, i + 1))
+                    uids.push_back(map.uids[i]);
+            }
+            map.uids.swap(uids);
+            build(map);
+        }
+
+        // The number of existing messages in the UID list positions 1 to pos.
+        uint32_t prefix(imap_uid_map_ctx &map, uint32_t pos)
+        {
+            uint32_t sum = 0;
+            for (uint32_t i = pos; i > 0 && i < map.tree.size(); i -= i & (~i + 1))
+                sum += map.tree[i];
+            return sum;
+        }
+
+        bool isExisting(imap_uid_map_ctx &map, uint32_t pos) { return prefix(map, pos) > prefix(map, pos - 1); }
+
+        // Find the UID list position (1-based) of message number.
+        uint32_t find(imap_uid_map_ctx &map, uint32_t msgNum)
+        {
+            uint32_t pos = 0, n = map.uids.size(), step = 1;
+            while (step * 2 <= n)
+                step *= 2;
+            for (; step > 0; step /= 2)
+            {
+                if (pos + step <= n && map.tree[pos + step] < msgNum)
+                {
+                    pos += step;
+                    msgNum -= map.tree[pos];
+                }
+            }
+            return pos + 1;
+        }
+
+        int indexOf(imap_uid_map_ctx &map, uint32_t uid)
+        {
+            if (!map.built || uid == 0)
+                return -1;
+            // The expunged messages with unknown UID have the UID of previous message.
+            uint32_t i = std::lower_bound(map.uids.begin(), map.uids.begin() + map.known, uid) - map.uids.begin();
+            for (; i < map.known && map.uids[i] == uid; i++)
+            {
+                if (isExisting(map, i + 1))
+                    return i;
+            }
+            return -1;
+        }
+
+        // Extend the leading known UIDs, the expunged messages with unknown UID are skipped.
+        void updateKnown(imap_uid_map_ctx &map)
+        {
+            while (map.known < map.uids.size())
+            {
+                if (map.uids[map.known] == 0)
+                {
+                    if (isExisting(map, map.known + 1))
+                        break;
+                    map.uids[map.known] = map.known > 0 ? map.uids[map.known - 1] : 0;
+                }
+                map.known++;
+            }
+        }
+    };
+}
+#endif
+#endif
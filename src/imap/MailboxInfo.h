@@ -14,7 +14,8 @@ namespace ReadyMailIMAP
 {
     typedef struct mailbox_info
     {
-        uint32_t msgCount = 0, RecentCount = 0, UIDValidity = 0, nextUID = 0, UnseenIndex = 0, highestModseq = 0;
+        uint32_t msgCount = 0, RecentCount = 0, UIDValidity = 0, nextUID = 0, UnseenIndex = 0;
+        uint64_t highestModseq = 0;
         bool noModseq = false;
         std::vector<String> flags, permanentFlags;
         String name;
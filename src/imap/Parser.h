@@ -11,6 +11,9 @@
 #include <Arduino.h>
 #include "Common.h"
 #include "./core/QBDecoder.h"
+#include "IMAPCache.h"
+#include "IMAPUIDMap.h"
+#include "IMAPMailboxDir.h"
 
 namespace ReadyMailIMAP
 {
@@ -20,6 +23,11 @@ namespace ReadyMailIMAP
         NumString numString;
 
     public:
+#if defined(ENABLE_FS)
+        IMAPCache cache;
+#endif
+        IMAPUIDMap uid_map;
+        IMAPMailboxDir mailbox_dir;
         IMAPParser() {}
         ~IMAPParser() {}
 
@@ -214,28 +222,18 @@ namespace ReadyMailIMAP
             return decoded;
         }
 
-        uint8_t *decodeText(uint8_t *decoded, int &decoded_len, const imap_file_ctx &cfile)
+        // Convert the text part chunk to UTF-8 in the buffer of context that is reused for all chunks,
+        // returns nullptr when no conversion is needed (UTF-8, unknown charset or pure ASCII chunk).
+        uint8_t *decodeText(imap_context *imap_ctx, uint8_t *decoded, int &decoded_len, const imap_file_ctx &cfile)
         {
-            uint8_t *out = nullptr;
-            if (cfile.text_part)
-            {
-                if (cfile.char_encoding == imap_char_encoding_scheme_iso8859_1)
-                {
-                    int len = (decoded_len + 1) * 2;
-                    unsigned char *buf = rd_mem<unsigned char *>(len, true);
-                    rd_dec_latin1_utf8(buf, &len, rd_cast<unsigned char *>(decoded), &decoded_len);
-                    decoded_len = len;
-                    out = rd_cast<uint8_t *>(buf);
-                }
-                else if (cfile.char_encoding == imap_char_encoding_scheme_tis_620 || cfile.char_encoding == imap_char_encoding_scheme_iso8859_11 || cfile.char_encoding == imap_char_encoding_scheme_windows_874)
-                {
-                    char *buf = rd_mem<char *>((decoded_len + 1) * 3, true);
-                    rd_dec_tis620_utf8(buf, rd_cast<const char *>(decoded), decoded_len);
-                    decoded_len = strlen(buf);
-                    out = rd_cast<uint8_t *>(buf);
-                }
-            }
-            return out;
+            if (!cfile.text_part || cfile.charset <= rd_charset_us_ascii || rd_charset_is_ascii(decoded, decoded_len))
+                return nullptr;
+
+            size_t len = decoded_len * 3;
+            if (imap_ctx->text_buf.size() < len)
+                imap_ctx->text_buf.resize(len);
+            decoded_len = rd_charset_decode(cfile.charset, decoded, decoded_len, rd_cast<char *>(imap_ctx->text_buf.data()), len);
+            return imap_ctx->text_buf.data();
         }
 
         String getField(part_ctx &cpart, imap_body_structure_non_multipart_fields field_type, int index = -1, bool key = false)
@@ -381,86 +379,130 @@ namespace ReadyMailIMAP
 
 #if defined(ENABLE_FS)
             if (imap_ctx->file && (imap_ctx->cb.file || cfile.fileCallback))
-                imap_ctx->file.write(decoded, decoded_len);
+                writeFile(imap_ctx, cfile, decoded, decoded_len);
 #endif
+            if (decoded_len > 0)
+                imap_ctx->digest.update(decoded, decoded_len);
+
+            if ((cfile.sink || cfile.sinkCb) && decoded_len > 0 && !writeSink(cfile, decoded, decoded_len))
+                sinkError(imap_ctx, cfile);
             cfile.chunk.index += decoded_len;
         }
 
-        String getEnc(const String &str)
+        // The digests are computed from the first decoded byte of body part and continued in the next fetch windows.
+        void beginDigest(imap_context *imap_ctx, imap_file_ctx &cfile)
         {
-            int pos1 = 0;
-            String enc;
-            int len = str.length();
-            while (pos1 < len - 1 && str[pos1] == ' ')
-                pos1++;
+            if (cfile.offset == 0)
+                imap_ctx->digest.begin(imap_ctx->options.digest_types);
+        }
 
-            if (pos1 < len - 1 && str[pos1] == '=' && str[pos1 + 1] == '?')
+        // Write the data to the part sink, the data that the sink does not accept (backpressure) are kept
+        // and written again with flushSink() before the server response is read.
+        bool writeSink(imap_file_ctx &cfile, const uint8_t *data, int len)
+        {
+            if (cfile.sink_buf.size() == 0)
             {
-                int pos2 = str.indexOf('?', pos1 + 2);
-                if (pos2 > -1)
-                    enc = str.substring(pos1 + 2, pos2);
+                int ret = sinkWrite(cfile, data, len);
+                if (ret < 0)
+                    return false;
+                if (ret == len)
+                    return true;
+                data += ret;
+                len -= ret;
+                cfile.sink_ms = millis();
             }
-            return enc;
+            cfile.sink_buf.insert(cfile.sink_buf.end(), data, data + len);
+            return true;
         }
 
-        void decodeStringImpl(QBDecoder &decoder, String &str, const String &enc)
+        // Write the pending data of part sinks, returns true when the data are still pending.
+        // The sink that does not accept any data within the send timeout is failed.
+        bool flushSink(imap_context *imap_ctx, imap_msg_ctx &cmsg)
         {
-            int i = 0;
-            String token, buf;
-            while (i < (int)str.length())
+            bool pending = false;
+            for (size_t i = 0; i < cmsg.files.size(); i++)
             {
-                token = nextToken(str, i, str.length());
-                if (token.length())
+                imap_file_ctx &cfile = cmsg.files[i];
+                while (cfile.sink_offset < cfile.sink_buf.size())
                 {
-                    String e = enc.length() ? enc : getEnc(token);
-                    decodeChunk(decoder, token, e);
-                    buf += token;
+                    int ret = sinkWrite(cfile, cfile.sink_buf.data() + cfile.sink_offset, cfile.sink_buf.size() - cfile.sink_offset);
+                    if (ret == 0 && millis() - cfile.sink_ms <= imap_ctx->options.timeout.send)
+                    {
+                        pending = true;
+                        break;
+                    }
+
+                    if (ret <= 0)
+                    {
+                        sinkError(imap_ctx, cfile);
+                        break;
+                    }
+                    cfile.sink_offset += ret;
+                    cfile.sink_ms = millis();
+                }
+
+                if (cfile.sink_buf.size() && cfile.sink_offset == cfile.sink_buf.size())
+                {
+                    cfile.sink_buf.clear();
+                    cfile.sink_offset = 0;
                 }
             }
-            str = buf;
+            return pending;
         }
 
-        void decodeChunk(QBDecoder &decoder, String &chunk, const String &enc)
+        // Returns the number of bytes that were accepted by the part sink or -1 for error.
+        int sinkWrite(imap_file_ctx &cfile, const uint8_t *data, int len)
         {
-            int bufSize = chunk.length() + 10;
-            char *buf = rd_mem<char *>(bufSize, true);
+            int ret = cfile.sink ? (int)cfile.sink->write(data, len) : cfile.sinkCb(data, len);
+            if (ret < 0 || (ret == 0 && cfile.sink && cfile.sink->getWriteError()))
+                return -1;
+            return ret > len ? len : ret;
+        }
 
-            // Content Q and B decodings
-            decoder.decode(buf, chunk.c_str(), bufSize);
+        void sinkError(imap_context *imap_ctx, imap_file_ctx &cfile)
+        {
+            cfile.sink = nullptr;
+            cfile.sinkCb = NULL;
+            std::vector<uint8_t>().swap(cfile.sink_buf);
+            cfile.sink_offset = 0;
+            imap_ctx->options.sink_error = true;
+        }
 
-            // Char set decoding
-            imap_char_encoding_scheme scheme = getCharEncoding(enc.c_str());
-            if (scheme == imap_char_encoding_scheme_iso8859_1)
-            {
-                int len = strlen(buf);
-                int olen = (len + 1) * 2;
-                unsigned char *out = rd_mem<unsigned char *>(olen, true);
-                rd_dec_latin1_utf8(out, &olen, rd_cast<unsigned char *>(buf), &len);
-                rd_free(&buf);
-                buf = rd_cast<char *>(out);
-            }
-            else if (scheme == imap_char_encoding_scheme_tis_620 || scheme == imap_char_encoding_scheme_iso8859_11 || scheme == imap_char_encoding_scheme_windows_874)
-            {
-                size_t len2 = strlen(buf);
-                char *out = rd_mem<char *>((len2 + 1) * 3, true);
-                rd_dec_tis620_utf8(out, rd_cast<const char *>(buf), len2);
-                rd_free(&buf);
-                buf = out;
-            }
-            chunk = buf;
-            rd_free(&buf);
+        // Convert the text of encoded word to UTF-8 with the charsets registry.
+        static int convertCharset(const char *charset, size_t charsetLen, const char *in, size_t inLen, char *out, size_t outSize)
+        {
+            int id = rd_charset_find(charset, charsetLen);
+            return id > rd_charset_us_ascii ? rd_charset_decode(id, rd_cast<const uint8_t *>(in), inLen, out, outSize) : -1;
         }
 
-        void decodeString(String &str, const char *enc = "")
+        // Decode the header value at index when it contains the encoded words.
+        void decodeHeader(imap_msg_ctx &cmsg, size_t index)
         {
-            if (str.startsWith("=?") || strlen(enc))
+            if (index < cmsg.headers.size() && (cmsg.encoded_headers & (1 << index)))
             {
-                // Handle rfc2047 Q (quoted printable) and B (base64) decodings
-                QBDecoder decoder;
-                decodeStringImpl(decoder, str, enc);
+                cmsg.encoded_headers &= ~(1 << index);
+                decodeHeader(cmsg.headers[index]);
             }
         }
 
+        // The address field contains the encoded names and the addresses e.g. =?UTF-8?Q?Al=C3=AFce?= <alice@ex.com>, Bob <bob@ex.com>
+        void decodeHeader(std::pair<String, String> &header) { decodeString(header.second); }
+
+        // Handle rfc2047 Q (quoted printable) and B (base64) decodings, the encoded words in other charsets are converted to UTF-8.
+        void decodeString(String &str)
+        {
+            if (str.indexOf("=?") == -1)
+                return;
+
+            QBDecoder decoder;
+            decoder.setCharsetCallback(convertCharset);
+            size_t size = str.length() * QB_DECODER_CHARSET_EXPANSION + 1;
+            char *buf = rd_mem<char *>(size);
+            decoder.decode(buf, str.c_str(), size);
+            str = buf;
+            rd_free(&buf);
+        }
+
         String getToken(const String &line, int pos, const String &beginToken, const String &lastToken)
         {
             int beginIndex = 0, lastIndex = 0, count = 0;
@@ -477,15 +519,10 @@ namespace ReadyMailIMAP
             return token;
         }
 
-        imap_char_encoding_scheme getCharEncoding(const String &enc)
+        int getCharsetId(const String &charset)
         {
-            imap_char_encoding_scheme scheme = imap_char_encoding_scheme_default;
-            for (int i = imap_char_encoding_utf8; i < imap_char_encoding_max_type; i++)
-            {
-                if (enc.indexOf(imap_char_encodings[i].text) > -1)
-                    scheme = (imap_char_encoding_scheme)i;
-            }
-            return scheme;
+            int start = charset.startsWith("\"") ? 1 : 0, end = charset.endsWith("\"") && charset.length() > 1 ? charset.length() - 1 : charset.length();
+            return rd_charset_find(charset.c_str() + start, end - start);
         }
 
         void parseBodyStructure(const String &line, const String &beginToken, const String &lastToken, int depth, int index, int field_type, std::vector<part_ctx> &parts, part_ctx *cpart)
@@ -606,7 +643,7 @@ namespace ReadyMailIMAP
             {
                 String token;
                 int beginIndex = 0, lastIndex = 0;
-                getBoundary(line, "CAPABILITY", "\r\n", beginIndex, lastIndex);
+                getBoundary(line, "CAPABILITY", line.indexOf("[CAPABILITY ") > -1 ? "]" : "\r\n", beginIndex, lastIndex);
                 int i = beginIndex;
                 while (i <= lastIndex)
                 {
@@ -641,12 +678,25 @@ namespace ReadyMailIMAP
                 {
                     imap_ctx->idle_status = "[-] " + getToken(line, 0, "* ", "EXPUNGE");
                     imap_ctx->current_message = numString.toNum(getToken(line, 0, "* ", "EXPUNGE").c_str());
-                    mailbox_info.msgCount = imap_ctx->current_message;
+                    if (mailbox_info.msgCount > 0)
+                        mailbox_info.msgCount--;
+                    // The UID map is updated after this event was added.
+                    addIdleEvent(imap_ctx->idle_queue, imap_idle_event_expunge, imap_ctx->current_message, 1, 0, uid_map.uid(imap_ctx->uid_map, imap_ctx->current_message));
+                }
+                else if (line.indexOf("VANISHED") > -1)
+                {
+                    // QRESYNC was enabled, the expunged messages are reported as UID set.
+                    String uids = getToken(line, 0, "VANISHED", "\r\n");
+                    imap_ctx->idle_status = "[-][UID] " + uids;
+                    imap_ctx->current_message = 0;
+                    parseVanishedEvents(uids, imap_ctx->idle_queue);
                 }
                 else if (line.indexOf("EXISTS") > -1)
                 {
                     imap_ctx->idle_status = "[+] " + getToken(line, 0, "* ", "EXISTS");
                     imap_ctx->current_message = numString.toNum(getToken(line, 0, "* ", "EXISTS").c_str());
+                    if (imap_ctx->current_message > mailbox_info.msgCount)
+                        addIdleEvent(imap_ctx->idle_queue, imap_idle_event_exists, mailbox_info.msgCount + 1, imap_ctx->current_message - mailbox_info.msgCount);
                     mailbox_info.msgCount = imap_ctx->current_message;
                 }
                 else if (line.indexOf("FETCH") > -1)
@@ -656,14 +706,244 @@ namespace ReadyMailIMAP
                     int beginIndex = 0, lastIndex = 0;
                     getBoundary(line, "FLAGS (", ")", beginIndex, lastIndex);
                     int i = beginIndex, count = 0;
+                    uint8_t flags = 0;
                     while (i <= lastIndex)
-                        imap_ctx->idle_status += (count++ > 0 ? ", " : "") + nextToken(line, i, lastIndex);
+                    {
+                        String flag = nextToken(line, i, lastIndex);
+                        flags |= getMessageFlag(flag);
+                        imap_ctx->idle_status += (count++ > 0 ? ", " : "") + flag;
+                    }
                     imap_ctx->idle_status += "] " + getToken(line, 0, "* ", "FETCH");
+                    int p = line.indexOf("UID ");
+                    uint32_t uid = p > 0 ? numString.toNum(line.c_str() + p + 4) : uid_map.uid(imap_ctx->uid_map, imap_ctx->current_message);
+                    addIdleEvent(imap_ctx->idle_queue, imap_idle_event_fetch, imap_ctx->current_message, 1, flags, uid);
+                }
+            }
+        }
+
+        uint8_t getMessageFlag(const String &flag)
+        {
+            static const char *names[] = {"\\Seen", "\\Answered", "\\Flagged", "\\Deleted", "\\Draft", "\\Recent"};
+            for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+            {
+                if (flag.equalsIgnoreCase(names[i]))
+                    return 1 << i;
+            }
+            return flag.length() ? imap_message_flag_keyword : 0;
+        }
+
+        // Add the UID ranges of VANISHED set e.g. "41,43:116" as the vanished events.
+        void parseVanishedEvents(const String &set, imap_idle_queue &queue)
+        {
+            int pos = 0;
+            uint32_t first = 0, last = 0;
+            while (nextRange(set, pos, first, last))
+                addIdleEvent(queue, imap_idle_event_vanished, first, last - first + 1, 0, first);
+        }
+
+        // Get the next range of sequence set e.g. "41,43:116", returns false when no range left.
+        bool nextRange(const String &set, int &pos, uint32_t &first, uint32_t &last)
+        {
+            while (pos < (int)set.length())
+            {
+                int end = set.indexOf(',', pos);
+                if (end < 0)
+                    end = set.length();
+                int p = set.indexOf(':', pos);
+                first = numString.toNum(set.substring(pos, p > -1 && p < end ? p : end).c_str());
+                last = p > -1 && p < end ? numString.toNum(set.substring(p + 1, end).c_str()) : first;
+                if (first > last)
+                    std::swap(first, last);
+                pos = end + 1;
+                if (first > 0)
+                    return true;
+            }
+            return false;
+        }
+
+        // Collect the UIDs from UID SEARCH or ESEARCH response for the UID map.
+        void parseUIDSearch(const String &line, imap_context *imap_ctx)
+        {
+            std::vector<uint32_t> &results = imap_ctx->uid_map.results;
+            if (line.indexOf(imap_ctx->tag) == 0)
+                return;
+
+            if (line.indexOf("* ESEARCH") == 0)
+            {
+                // * ESEARCH (TAG "ReadyMail") UID ALL 1:3,5
+                int pos = line.indexOf(" ALL ");
+                if (pos > -1)
+                {
+                    String set = getToken(line, 0, " ALL ", "\r\n");
+                    uint32_t first = 0, last = 0;
+                    pos = 0;
+                    while (nextRange(set, pos, first, last))
+                    {
+                        for (uint32_t uid = first; uid <= last && uid > 0; uid++)
+                            results.push_back(uid);
+                    }
+                }
+                return;
+            }
+
+            // The long SEARCH response line is read in chunks, the next chunks do not begin with "*".
+            if (line[0] == '*' && line.indexOf("* SEARCH") != 0)
+                return;
+
+            int beginIndex = 0, lastIndex = 0;
+            getBoundary(line, "* SEARCH", line[line.length() - 1] == ' ' ? " " : "\r\n", beginIndex, lastIndex);
+            int i = beginIndex;
+            while (i <= lastIndex)
+            {
+                uint32_t uid = numString.toNum(nextToken(line, i, lastIndex).c_str());
+                if (uid > 0)
+                    results.push_back(uid);
+            }
+        }
+
+        // Update the UID map from the untagged EXPUNGE, EXISTS, VANISHED and FETCH (UID) responses.
+        void trackUIDMap(const String &line, imap_context *imap_ctx)
+        {
+            imap_uid_map_ctx &map = imap_ctx->uid_map;
+            if (!uid_map.isBuilt(map) || line.length() < 4 || line[0] != '*' || line[1] != ' ')
+                return;
+
+            if (line.indexOf("* VANISHED") == 0 && line.indexOf("(EARLIER)") == -1)
+            {
+                String set = getToken(line, 0, "VANISHED", "\r\n");
+                int pos = 0;
+                uint32_t first = 0, last = 0;
+                while (nextRange(set, pos, first, last))
+                    uid_map.vanish(map, first, last);
+            }
+            else if (line[2] >= '0' && line[2] <= '9')
+            {
+                uint32_t number = numString.toNum(line.c_str() + 2);
+                if (line.indexOf(" EXPUNGE") > 0)
+                    uid_map.expunge(map, number);
+                else if (line.indexOf(" EXISTS") > 0)
+                    uid_map.exists(map, number);
+                else if (line.indexOf(" FETCH (") > 0)
+                {
+                    uint32_t uid = getFetchUID(line);
+                    if (uid > 0)
+                        uid_map.setUID(map, number, uid);
                 }
             }
         }
 
-        void parseSearch(const String &line, imap_context *imap_ctx, std::vector<uint32_t> &imap_msg_num)
+        // Provides the UID data item of FETCH response or 0 if it was not found. The data items can be in any order
+        // e.g. * 1 FETCH (ENVELOPE (...) BODY (...) UID 7), the strings, literals and lists of other data items are skipped.
+        uint32_t getFetchUID(const String &line)
+        {
+            int i = line.indexOf(" FETCH ("), len = line.length(), depth = 0;
+            if (i < 0)
+                return 0;
+
+            for (i += 7; i < len; i++)
+            {
+                char c = line[i];
+                if (c == '"')
+                {
+                    while (++i < len && line[i] != '"')
+                    {
+                        if (line[i] == '\\')
+                            i++;
+                    }
+                }
+                else if (c == '{')
+                {
+                    // The literal {n}\r\n follows by n octets.
+                    int p = line.indexOf('}', i);
+                    if (p < 0)
+                        return 0;
+                    i = p + 2 + numString.toNum(line.substring(i + 1, p).c_str());
+                }
+                else if (c == '(')
+                    depth++;
+                else if (c == ')')
+                {
+                    if (--depth == 0)
+                        break;
+                }
+                else if (depth == 1 && (line[i - 1] == ' ' || line[i - 1] == '(') && strncmp(line.c_str() + i, "UID ", 4) == 0)
+                    return numString.toNum(line.c_str() + i + 4);
+            }
+            return 0;
+        }
+
+        // Push the event to the IDLE event queue, the event will be merged with the newest event
+        // when coalescing is enabled and both events are in the same or adjacent range.
+        void addIdleEvent(imap_idle_queue &queue, imap_idle_event_type type, uint32_t msgNum, uint32_t count, uint8_t flags = 0, uint32_t uid = 0)
+        {
+            if (queue.coalesce && queue.count > 0)
+            {
+                IMAPIdleEvent &last = queue.events[(queue.head + queue.count - 1) % IMAP_IDLE_EVENT_QUEUE_SIZE];
+                if (last.type == type)
+                {
+                    switch (type)
+                    {
+                    case imap_idle_event_exists:
+                    case imap_idle_event_vanished:
+                        if (msgNum == last.msgNum + last.count)
+                        {
+                            last.count += count;
+                            return;
+                        }
+                        break;
+
+                    case imap_idle_event_expunge:
+                        // The message numbers are shifted after each removal, the same number
+                        // or the number before the range is in the range of original numbers.
+                        if (msgNum == last.msgNum || msgNum + 1 == last.msgNum)
+                        {
+                            if (msgNum != last.msgNum)
+                                last.uid = uid;
+                            last.msgNum = msgNum;
+                            last.count++;
+                            return;
+                        }
+                        break;
+
+                    case imap_idle_event_fetch:
+                        if (last.count == 1 && msgNum == last.msgNum)
+                        {
+                            last.flags = flags;
+                            last.uid = uid > 0 ? uid : last.uid;
+                            return;
+                        }
+                        else if (flags == last.flags && msgNum == last.msgNum + last.count)
+                        {
+                            last.count++;
+                            return;
+                        }
+                        break;
+
+                    default:
+                        break;
+                    }
+                }
+            }
+
+            if (queue.count == IMAP_IDLE_EVENT_QUEUE_SIZE)
+            {
+                // Overwrite the oldest event.
+                queue.head = (queue.head + 1) % IMAP_IDLE_EVENT_QUEUE_SIZE;
+                queue.count--;
+                queue.dropped++;
+            }
+
+            IMAPIdleEvent &event = queue.events[(queue.head + queue.count) % IMAP_IDLE_EVENT_QUEUE_SIZE];
+            event.type = type;
+            event.msgNum = msgNum;
+            event.count = count;
+            event.flags = flags;
+            event.uid = uid;
+            queue.count++;
+        }
+
+        // Parse the SEARCH or SORT response, the SORT result is kept in the server order.
+        void parseSearch(const String &line, imap_context *imap_ctx, std::vector<uint32_t> &imap_msg_num, const char *beginToken = "* SEARCH")
         {
             if (line.indexOf(imap_ctx->tag) > -1)
             {
@@ -674,7 +954,7 @@ namespace ReadyMailIMAP
 
             String token;
             int beginIndex = 0, lastIndex = 0;
-            getBoundary(line, "* SEARCH", line[line.length() - 1] == ' ' ? " " : "\r\n", beginIndex, lastIndex);
+            getBoundary(line, beginToken, line[line.length() - 1] == ' ' ? " " : "\r\n", beginIndex, lastIndex);
             int i = beginIndex;
 
             while (i <= lastIndex)
@@ -697,6 +977,62 @@ namespace ReadyMailIMAP
             }
         }
 
+        // Parse the THREAD response e.g. * THREAD (2)(3 6 (4 23)(44 7 96)), the long response line that was split
+        // at space is continued from the parsing state.
+        void parseThread(const String &line, imap_context *imap_ctx)
+        {
+            imap_thread_ctx &thread = imap_ctx->thread;
+            int i = 0;
+            if (line.indexOf("* THREAD") == 0)
+                i = 8;
+            else if (line[0] == '*' || line.indexOf(imap_ctx->tag) == 0)
+                return;
+
+            for (; i < (int)line.length(); i++)
+            {
+                if (line[i] == '(')
+                {
+                    // The thread that its root message is missing e.g. ((3)(5)).
+                    if (thread.stack.size() > 0 && thread.last == -1)
+                        thread.last = addThreadNode(thread, 0, thread.parent);
+                    thread.stack.push_back(std::pair<int, int>(thread.parent, thread.last));
+                    thread.parent = thread.stack.size() > 1 ? thread.last : -1;
+                    thread.last = -1;
+                }
+                else if (line[i] == ')' && thread.stack.size() > 0)
+                {
+                    thread.parent = thread.stack.back().first;
+                    thread.last = thread.stack.back().second;
+                    thread.stack.pop_back();
+                }
+                else if (isdigit(line[i]) && thread.stack.size() > 0)
+                {
+                    uint32_t num = 0;
+                    while (i < (int)line.length() && isdigit(line[i]))
+                        num = num * 10 + (line[i++] - '0');
+                    i--;
+                    thread.last = addThreadNode(thread, num, thread.last > -1 ? thread.last : thread.parent);
+                }
+            }
+        }
+
+        int addThreadNode(imap_thread_ctx &thread, uint32_t num, int parent)
+        {
+            IMAPThreadNode node;
+            node.msgNum = num;
+            node.parent = parent;
+            int index = thread.nodes.size();
+            int &tail = parent > -1 ? thread.tails[parent] : thread.root_tail;
+            if (tail > -1)
+                thread.nodes[tail].nextSibling = index;
+            else if (parent > -1)
+                thread.nodes[parent].firstChild = index;
+            tail = index;
+            thread.nodes.push_back(node);
+            thread.tails.push_back(-1);
+            return index;
+        }
+
         void parseMailbox(const String &line, std::array<String, 3> &buf)
         {
             int beginIndex = 0, lastIndex = 0, count = 0;
@@ -713,6 +1049,49 @@ namespace ReadyMailIMAP
             }
         }
 
+        // Parse the STATUS response e.g. * STATUS "INBOX" (MESSAGES 17 UNSEEN 16 UIDNEXT 44)
+        void parseStatus(const String &line, imap_context *imap_ctx)
+        {
+            IMAPMailboxStatus status;
+            int i = 9, p = 0;
+            if (line[i] == '"')
+            {
+                while (++i < (int)line.length() && line[i] != '"')
+                {
+                    if (line[i] == '\\' && i + 1 < (int)line.length())
+                        i++;
+                    status.name += line[i];
+                }
+                p = line.indexOf('(', i);
+            }
+            else
+            {
+                p = line.indexOf(" (", i);
+                status.name = line.substring(i, p);
+            }
+
+            if (p < 0 || status.name.length() == 0)
+                return;
+
+            // The mailbox name may contain the parenthesis.
+            String items = line.substring(p);
+            int beginIndex = 0, lastIndex = 0;
+            getBoundary(items, "(", ")", beginIndex, lastIndex);
+            i = beginIndex;
+            while (i <= lastIndex)
+            {
+                String item = nextToken(items, i, lastIndex);
+                uint32_t value = numString.toNum(nextToken(items, i, lastIndex).c_str());
+                if (item == "MESSAGES")
+                    status.messages = value;
+                else if (item == "UNSEEN")
+                    status.unseen = value;
+                else if (item == "UIDNEXT")
+                    status.uidNext = value;
+            }
+            imap_ctx->mailbox_status->push_back(status);
+        }
+
         void parseExamine(const String &line, MailboxInfo &mailbox_info, imap_context *imap_ctx)
         {
             if (line.indexOf("EXISTS") > -1)
@@ -728,11 +1107,50 @@ namespace ReadyMailIMAP
             else if (line.indexOf("[UNSEEN") > -1)
                 mailbox_info.UnseenIndex = numString.toNum(getToken(line, 0, "[UNSEEN", "]").c_str());
             else if (imap_ctx->feature_caps[imap_read_cap_condstore] && line.indexOf("[HIGHESTMODSEQ") > -1)
-                mailbox_info.highestModseq = numString.toNum(getToken(line, 0, "[HIGHESTMODSEQ", "]").c_str());
+                mailbox_info.highestModseq = toModseq(getToken(line, 0, "[HIGHESTMODSEQ", "]"));
             else if (line.indexOf("NOMODSEQ") > -1)
                 mailbox_info.noModseq = true;
         }
 
+        // The modification sequence is 63-bit unsigned number (RFC 7162).
+        uint64_t toModseq(const String &str) { return strtoull(str.c_str(), nullptr, 10); }
+
+        bool isSyncResponse(const String &line) { return line.indexOf("* VANISHED") == 0 || (line[0] == '*' && line.indexOf(" FETCH (") > -1); }
+
+        // Parse the changes of mailbox e.g.
+        // * 49 FETCH (UID 49 FLAGS (\Seen) MODSEQ (12121231000))
+        // * VANISHED (EARLIER) 41,43:116
+        void parseSync(const String &line, imap_context *imap_ctx)
+        {
+            IMAPSyncData data;
+            if (line.indexOf("* VANISHED") == 0)
+            {
+                data.event = imap_sync_event_vanished;
+                data.uids = getToken(line, 0, line.indexOf("(EARLIER)") > -1 ? "(EARLIER)" : "VANISHED", "\r\n");
+            }
+            else
+            {
+                data.event = imap_sync_event_changed;
+                data.number = numString.toNum(getToken(line, 0, "* ", "FETCH").c_str());
+                data.uid = getFetchUID(line);
+                if (line.indexOf("MODSEQ (") > -1)
+                    data.modseq = toModseq(getToken(line, 0, "MODSEQ (", ")"));
+
+                int beginIndex = 0, lastIndex = 0;
+                getBoundary(line, "FLAGS (", ")", beginIndex, lastIndex);
+                int i = beginIndex, count = 0;
+                while (line.indexOf("FLAGS (") > -1 && i <= lastIndex)
+                {
+                    String flag = nextToken(line, i, lastIndex);
+                    if (flag.length())
+                        data.flags += (count++ > 0 ? " " : "") + flag;
+                }
+            }
+
+            if (imap_ctx->cb.sync)
+                imap_ctx->cb.sync(data);
+        }
+
         void parseFlags(const String &line, MailboxInfo &mailbox_info)
         {
             bool permanent = line.indexOf("PERMANENTFLAGS") > -1;
@@ -748,7 +1166,9 @@ namespace ReadyMailIMAP
             }
         }
 
-        void parseEnvelope(imap_context *imap_ctx, imap_msg_ctx &cmsg, const String &line, const String &beginToken, const String &lastToken, int depth, String *header, int &header_index)
+        bool isEnvelopeField(imap_context *imap_ctx, int field) { return field < imap_envelpe_max_type && (imap_ctx->options.envelope_fields & (1 << field)); }
+
+        void parseEnvelope(imap_context *imap_ctx, imap_msg_ctx &cmsg, const String &line, const String &beginToken, const String &lastToken, int depth, String *header, int &header_index, uint16_t &encoded)
         {
             int beginIndex = 0, lastIndex = 0;
             getBoundary(line, beginToken, lastToken, beginIndex, lastIndex);
@@ -762,7 +1182,7 @@ namespace ReadyMailIMAP
                 {
                     if (token[0] == '(' && token[token.length() - 1] == ')')
                     {
-                        parseEnvelope(imap_ctx, cmsg, token, "(", ")", depth + 1, header, header_index);
+                        parseEnvelope(imap_ctx, cmsg, token, "(", ")", depth + 1, header, header_index, encoded);
                         if (depth == 0)
                             header_index++;
                     }
@@ -770,17 +1190,19 @@ namespace ReadyMailIMAP
                     {
                         if (depth == 0)
                         {
-                            if (token != "NIL")
+                            if (token != "NIL" && isEnvelopeField(imap_ctx, header_index))
                             {
-                                decodeString(token);
+                                // The encoded words are decoded on first access.
+                                if (token.startsWith("=?"))
+                                    encoded |= 1 << header_index;
                                 header[header_index] = token;
                             }
                             header_index++;
                         }
-                        else if (depth == 2)
+                        else if (depth == 2 && isEnvelopeField(imap_ctx, header_index))
                         {
-                            if (addr_index == 0 && token != "NIL")
-                                decodeString(token);
+                            if (addr_index == 0 && token.startsWith("=?"))
+                                encoded |= 1 << header_index;
                             addr_struct[addr_index] = token;
                             addr_index++;
 
@@ -809,6 +1231,14 @@ namespace ReadyMailIMAP
 
         void parseFetch(String &line, imap_context *imap_ctx, imap_msg_ctx &cmsg, imap_state &cstate, imap_file_ctx &cfile)
         {
+            if (cstate == imap_state_fetch_body_part && cmsg.octet_counting)
+            {
+                if (line[0] == '*')
+                    cmsg.exists = true;
+                parseBodyLiteral(line, imap_ctx, cmsg);
+                return;
+            }
+
             if (line[0] == '*' || imap_ctx->options.multiline)
             {
                 cmsg.exists = true;
@@ -831,29 +1261,41 @@ namespace ReadyMailIMAP
                         IMAPBase::setDebug(imap_ctx, line, true);
 #endif
 
+                    cmsg.uid = getFetchUID(line);
+                    if (cmsg.uid == 0 && imap_ctx->options.uid_fetch)
+                        cmsg.uid = imap_ctx->options.fetch_number;
+
                     String header[imap_envelpe_max_type];
                     int i = imap_envelpe_date;
-                    parseEnvelope(imap_ctx, cmsg, line, "ENVELOPE (", ")", 0, header, i);
+                    uint16_t encoded = 0;
+                    parseEnvelope(imap_ctx, cmsg, line, "ENVELOPE (", ")", 0, header, i, encoded);
 
                     for (i = imap_envelpe_date; i < imap_envelpe_max_type; i++)
-                        cmsg.headers.emplace_back(imap_envelopes[i].text, header[i]);
+                    {
+                        if (isEnvelopeField(imap_ctx, i))
+                        {
+                            if (encoded & (1 << i))
+                                cmsg.encoded_headers |= 1 << cmsg.headers.size();
+                            cmsg.headers.emplace_back(imap_envelopes[i].text, header[i]);
+                            cmsg.field_headers[i] = cmsg.headers.size();
+                        }
+                    }
 
-                    if (imap_ctx->cb.data)
+#if defined(ENABLE_FS)
+                    if (cache.isEnabled(imap_ctx))
                     {
-                        imap_ctx->cb_data.files = &cmsg.files;
-                        imap_ctx->cb_data.fileIndex = &cmsg.cur_file_index;
-                        imap_ctx->cb_data.headers = &cmsg.headers;
-                        imap_ctx->cb_data.msgIndex = &imap_ctx->cur_msg_index;
-                        imap_ctx->cb_data.eventType = imap_ctx->options.searching ? imap_data_event_search : imap_data_event_fetch_envelope;
-                        imap_ctx->cb.data(imap_ctx->cb_data);
-                        cmsg.fetch_count = 0;
-                        for (size_t j = 0; j < cmsg.files.size(); j++)
-                            cmsg.fetch_count += cmsg.files[j].fetch ? 1 : 0;
+                        // The cache stores the decoded values.
+                        for (size_t j = 0; j < cmsg.headers.size(); j++)
+                            decodeHeader(cmsg, j);
+                        cache.write(imap_ctx, cmsg);
                     }
+#endif
+                    envelopeReady(imap_ctx, cmsg);
                 }
                 else if (cstate == imap_state_fetch_body_part)
                 {
                     imap_ctx->cb_data.eventType = imap_data_event_fetch_body;
+                    beginDigest(imap_ctx, cfile);
 #if defined(ENABLE_FS)
                     openFile(imap_ctx, cfile);
 #endif
@@ -864,6 +1306,7 @@ namespace ReadyMailIMAP
                 if (line.indexOf(imap_ctx->tag) != 0)
                 {
                     String res;
+                    cfile.offset += line.length();
                     int rlen = readContent(line, res, cfile, cmsg);
                     if (rlen)
                     {
@@ -872,59 +1315,351 @@ namespace ReadyMailIMAP
                         // some server reports incorrect octet count in none-base64 transfer encoding.
                         // Then we check for last octet bytes sequence ')\r\n' every line and remove it before decoding
                         removeLastOctet(res, cfile);
+                        storeContent(res, rlen, cfile, cmsg, imap_ctx);
+                        updateCheckpoint(imap_ctx, cfile, cmsg);
+                    }
+                }
+                else
+                    completeContent(cfile, imap_ctx);
+            }
+        }
 
-                        int decoded_len = 0;
-                        if (cfile.transfer_encoding == imap_transfer_encoding_base64 || cfile.transfer_encoding == imap_transfer_encoding_binary)
-                            removeLinebreak(res, rlen);
+#if defined(ENABLE_FS)
+        // Read the message envelope of UID from the cache instead of fetching from server.
+        bool readCachedEnvelope(imap_context *imap_ctx, imap_msg_ctx &cmsg, uint32_t uid)
+        {
+            if (!cache.isEnabled(imap_ctx) || !cache.read(imap_ctx, uid, cmsg))
+                return false;
+
+            for (size_t i = 0; i < cmsg.files.size(); i++)
+                setFileOptions(imap_ctx, cmsg.files[i]);
+
+            // The message sequence number is not known.
+            imap_ctx->current_message = 0;
+            cmsg.exists = true;
+            cmsg.cached = true;
+            envelopeReady(imap_ctx, cmsg);
+            return true;
+        }
+#endif
 
-                        uint8_t *decoded = decodeContent(res, decoded_len, cfile, cmsg);
-                        if (decoded)
-                        {
-                            if (decoded_len)
-                            {
-                                int out_len = 0;
+        // Provide the message envelope to the data callback and count the body parts to fetch.
+        void envelopeReady(imap_context *imap_ctx, imap_msg_ctx &cmsg)
+        {
+            imap_ctx->cb_data.files = &cmsg.files;
+            imap_ctx->cb_data.fileIndex = &cmsg.cur_file_index;
+            imap_ctx->cb_data.headers = &cmsg.headers;
+            imap_ctx->cb_data.encodedHeaders = &cmsg.encoded_headers;
+            imap_ctx->cb_data.fieldHeaders = cmsg.field_headers;
+            imap_ctx->cb_data.parser = this;
+            imap_ctx->cb_data.msgIndex = &imap_ctx->cur_msg_index;
+            imap_ctx->cb_data.msgUID = cmsg.uid;
 
-                                if (cfile.info.mime.startsWith("text/") && cfile.textEncCb)
-                                {
-                                    int len = (decoded_len + 1) * 4;
-                                    uint8_t *out = rd_mem<uint8_t *>(len, true);
-                                    cfile.textEncCb(cfile.info.charset, decoded, decoded_len, out, out_len);
-                                    if (out_len > 0)
-                                    {
-                                        updateDownloadStatus(decoded_len, cfile);
-                                        storeDecodedData(out, out_len, false, cfile, imap_ctx);
-                                    }
-                                    rd_free(&out);
-                                }
+            if (imap_ctx->cb.data)
+            {
+                imap_ctx->cb_data.eventType = imap_ctx->options.searching ? imap_data_event_search : imap_data_event_fetch_envelope;
+                imap_ctx->cb.data(imap_ctx->cb_data);
+            }
 
-                                if (out_len == 0)
-                                {
-                                    uint8_t *buf = decodeText(decoded, decoded_len, cfile);
-                                    updateDownloadStatus(decoded_len, cfile);
-                                    storeDecodedData(buf ? buf : decoded, decoded_len, false, cfile, imap_ctx);
-                                    rd_free(&buf);
-                                }
-                            }
-                            rd_free(&decoded);
-                        }
+            if (imap_ctx->options.resume)
+                setResumePoint(imap_ctx, cmsg);
+
+            cmsg.fetch_count = 0;
+            for (size_t j = 0; j < cmsg.files.size(); j++)
+                cmsg.fetch_count += cmsg.files[j].fetch ? 1 : 0;
+        }
+
+        // Parse the body part literals of FETCH command response by counting the literal octets, e.g.
+        // * 1 FETCH (BODY[1] {n}\r\n...n octets... BODY[2] {m}\r\n...m octets...)\r\n
+        // * 1 FETCH (BODY[1]<4096> {n}\r\n...n octets...)\r\n
+        // The current file is switched when the next literal begins.
+        void parseBodyLiteral(const String &line, imap_context *imap_ctx, imap_msg_ctx &cmsg)
+        {
+            int pos = 0, len = line.length();
+
+            if (line.indexOf(imap_ctx->tag) == 0)
+            {
+                // The literal was truncated, complete the current body part anyway.
+                if (cmsg.octet_remaining > 0 && cmsg.cur_file_index < (int)cmsg.files.size())
+                {
+                    cmsg.octet_remaining = 0;
+                    cmsg.partial_literal = false;
+                    completeLiteral(imap_ctx, cmsg, cmsg.files[cmsg.cur_file_index]);
+                }
+                return;
+            }
+
+            while (pos < len)
+            {
+                if (cmsg.octet_remaining == 0)
+                {
+                    // The body part item e.g. BODY[1.2] {n} is expected and it could be split by line read limit.
+                    cmsg.item_chunk += pos > 0 ? line.substring(pos) : line;
+                    if (cmsg.item_chunk[cmsg.item_chunk.length() - 1] != '\n')
+                        return;
+
+                    String item = cmsg.item_chunk;
+                    clear(cmsg.item_chunk);
+
+                    // BODY[1.2] or BINARY[1.2] item.
+                    int p1 = item.indexOf("BODY["), plen = 5;
+                    if (p1 == -1)
+                    {
+                        p1 = item.indexOf("BINARY[");
+                        plen = 7;
+                    }
+                    int p2 = p1 > -1 ? item.indexOf(']', p1) : -1;
+                    if (p2 == -1)
+                        return;
+
+                    String section = item.substring(p1 + plen, p2);
+                    int index = -1;
+                    for (int i = 0; i < (int)cmsg.files.size(); i++)
+                    {
+                        if (cmsg.files[i].section == section)
+                            index = i;
                     }
+
+                    if (index == -1)
+                        return;
+
+                    cmsg.cur_file_index = index;
+                    imap_file_ctx &cfile = cmsg.files[index];
+                    imap_ctx->cb_data.eventType = imap_data_event_fetch_body;
+                    beginDigest(imap_ctx, cfile);
+#if defined(ENABLE_FS)
+                    // The file is kept open between the ranged fetches, and opened for appending when resuming.
+                    if (cfile.offset == 0 || !imap_ctx->file)
+                        openFile(imap_ctx, cfile, cfile.offset > 0);
+#endif
+                    cmsg.octet_remaining = getOctetLen(item.substring(p2));
+                    cmsg.partial_literal = cmsg.octet_request > 0 && cmsg.octet_remaining >= cmsg.octet_request;
+                    cfile.window_pending = false;
+
+                    // NIL or empty string
+                    if (cmsg.octet_remaining == 0)
+                        completeLiteral(imap_ctx, cmsg, cfile);
+                    return;
                 }
                 else
                 {
-                    cfile.progress.value = 100.0f;
-                    cfile.progress.last_value = -1;
-                    storeDecodedData(nullptr, 0, true, cfile, imap_ctx);
+                    imap_file_ctx &cfile = cmsg.files[cmsg.cur_file_index];
+                    int size = len - pos;
+                    if ((uint32_t)size > cmsg.octet_remaining)
+                        size = cmsg.octet_remaining;
+
+                    String res, chunk = pos == 0 && size == len ? line : line.substring(pos, pos + size);
+                    pos += size;
+                    cmsg.octet_remaining -= size;
+                    cfile.total_read += size;
+                    cfile.offset += size;
+
+                    // The linebreak was split by the end of previous window.
+                    if (cmsg.raw_chunk.length() && cmsg.raw_chunk[cmsg.raw_chunk.length() - 1] == '\r' && chunk[0] == '\n')
+                    {
+                        res = cmsg.raw_chunk;
+                        res += '\n';
+                        clear(cmsg.raw_chunk);
+                        chunk.remove(0, 1);
+                        storeContent(res, res.length(), cfile, cmsg, imap_ctx);
+                        updateCheckpoint(imap_ctx, cfile, cmsg);
+                    }
+
+                    int rlen = chunk.length() ? readContent(chunk, res, cfile, cmsg) : 0;
+                    if (rlen)
+                    {
+                        storeContent(res, rlen, cfile, cmsg, imap_ctx);
+                        updateCheckpoint(imap_ctx, cfile, cmsg);
+                    }
+
+                    if (cmsg.octet_remaining == 0)
+                        completeLiteral(imap_ctx, cmsg, cfile);
+                }
+            }
+        }
+
+        // The server may reject the BINARY fetch e.g. NO [UNKNOWN-CTE] when it cannot decode the transfer encoding.
+        // The requested body parts that were not received yet are marked to fetch with BODY and decoded by client.
+        bool rejectBinary(imap_msg_ctx &cmsg, int fileIndex)
+        {
+            bool rejected = false;
+            for (int i = fileIndex; i > -1 && i < (int)cmsg.files.size() && (cmsg.multipart || i == fileIndex); i++)
+            {
+                imap_file_ctx &cfile = cmsg.files[i];
+                if (cfile.fetch && cfile.binary && cfile.offset == 0 && cfile.total_read == 0)
+                {
+                    cfile.binary = false;
+                    cfile.binary_rejected = true;
+                    rejected = true;
+                }
+            }
+            return rejected;
+        }
+
+        // The literal octets of BINARY item is being received, which should be read as is (may contain NUL and linebreak octets).
+        bool binaryLiteral(imap_msg_ctx &cmsg)
+        {
+            return cmsg.octet_counting && cmsg.octet_remaining > 0 && cmsg.cur_file_index < (int)cmsg.files.size() && cmsg.files[cmsg.cur_file_index].binary;
+        }
+
+        // Parse the octets of BINARY item literal e.g.
+        // * 1 FETCH (BINARY[2] ~{n}\r\n...n octets...)\r\n
+        // The octets are already decoded by server and are stored without transfer decoding.
+        void parseBinaryLiteral(uint8_t *data, int len, imap_context *imap_ctx, imap_msg_ctx &cmsg)
+        {
+            imap_file_ctx &cfile = cmsg.files[cmsg.cur_file_index];
+            if ((uint32_t)len > cmsg.octet_remaining)
+                len = cmsg.octet_remaining;
+
+            cmsg.octet_remaining -= len;
+            cfile.total_read += len;
+            cfile.offset += len;
+            storeDecoded(data, len, cfile, imap_ctx);
+            updateCheckpoint(imap_ctx, cfile, cmsg);
+
+            if (cmsg.octet_remaining == 0)
+                completeLiteral(imap_ctx, cmsg, cfile);
+        }
+
+        void completeLiteral(imap_context *imap_ctx, imap_msg_ctx &cmsg, imap_file_ctx &cfile)
+        {
+            // The requested window was filled, the rest of body part will be fetched in the next window.
+            if (cmsg.partial_literal)
+            {
+                cfile.window_pending = true;
+                return;
+            }
+
+            // The last octets of body part which may not end with linebreak.
+            String res = cmsg.raw_chunk;
+            clear(cmsg.raw_chunk);
+            if (res.length())
+                storeContent(res, res.length(), cfile, cmsg, imap_ctx);
+
+            // Flush the pending quoted-printable soft line break data.
+            if (cmsg.qp_chunk.length())
+            {
+                clear(res);
+                storeContent(res, 0, cfile, cmsg, imap_ctx);
+            }
+            updateCheckpoint(imap_ctx, cfile, cmsg);
+            completeContent(cfile, imap_ctx);
+        }
+
+        void updateCheckpoint(imap_context *imap_ctx, imap_file_ctx &cfile, imap_msg_ctx &cmsg)
+        {
+            // All received octets were decoded and stored.
+            if (cmsg.raw_chunk.length() == 0 && cmsg.qp_chunk.length() == 0)
+            {
+                cfile.pending_checkpoint = cfile.offset - (cfile.last_octet ? 3 : 0);
+                cfile.pending_checkpoint_index = cfile.chunk.index;
+            }
+            commitCheckpoint(imap_ctx, cfile);
+        }
+
+        // The resumable checkpoint should not include the decoded data that are still in the file write buffer.
+        void commitCheckpoint(imap_context *imap_ctx, imap_file_ctx &cfile)
+        {
 #if defined(ENABLE_FS)
-                    closeFile(imap_ctx);
+            if (cfile.pending_checkpoint_index + imap_ctx->file_sink.buf.size() > cfile.chunk.index)
+                return;
+#else
+            (void)imap_ctx;
 #endif
+            cfile.checkpoint = cfile.pending_checkpoint;
+            cfile.checkpoint_index = cfile.pending_checkpoint_index;
+        }
+
+        void setResumePoint(imap_context *imap_ctx, imap_msg_ctx &cmsg)
+        {
+#if defined(ENABLE_FS)
+            // The data that were left in buffer by the interrupted download are beyond the resume point.
+            imap_ctx->file_sink.buf.clear();
+#endif
+            // The digests of resumed body part cannot be computed.
+            imap_ctx->digest.begin(readymail_digest_none);
+            for (size_t i = 0; i < cmsg.files.size(); i++)
+            {
+                imap_file_ctx &cfile = cmsg.files[i];
+                cfile.fetch = cfile.section == imap_ctx->resume_point.section;
+                if (cfile.fetch)
+                {
+                    cfile.offset = imap_ctx->resume_point.offset;
+                    cfile.total_read = cfile.offset;
+                    cfile.checkpoint = cfile.offset;
+                    cfile.pending_checkpoint = cfile.offset;
+                    cfile.chunk.index = imap_ctx->resume_point.index;
+                    cfile.checkpoint_index = cfile.chunk.index;
+                    cfile.pending_checkpoint_index = cfile.chunk.index;
+                    cfile.binary = imap_ctx->resume_point.binary;
                 }
             }
         }
 
+        void storeContent(String &res, int rlen, imap_file_ctx &cfile, imap_msg_ctx &cmsg, imap_context *imap_ctx)
+        {
+            int decoded_len = 0;
+            if (cfile.transfer_encoding == imap_transfer_encoding_base64 || cfile.transfer_encoding == imap_transfer_encoding_binary)
+                removeLinebreak(res, rlen);
+
+            uint8_t *decoded = decodeContent(res, decoded_len, cfile, cmsg);
+            if (decoded)
+            {
+                storeDecoded(decoded, decoded_len, cfile, imap_ctx);
+                rd_free(&decoded);
+            }
+        }
+
+        void storeDecoded(uint8_t *decoded, int decoded_len, imap_file_ctx &cfile, imap_context *imap_ctx)
+        {
+            if (decoded_len)
+            {
+                int out_len = 0;
+
+                if (cfile.info.mime.startsWith("text/") && cfile.textEncCb)
+                {
+                    int len = (decoded_len + 1) * 4;
+                    uint8_t *out = rd_mem<uint8_t *>(len, true);
+                    cfile.textEncCb(cfile.info.charset, decoded, decoded_len, out, out_len);
+                    if (out_len > 0)
+                    {
+                        updateDownloadStatus(decoded_len, cfile);
+                        storeDecodedData(out, out_len, false, cfile, imap_ctx);
+                    }
+                    rd_free(&out);
+                }
+
+                if (out_len == 0)
+                {
+                    uint8_t *buf = decodeText(imap_ctx, decoded, decoded_len, cfile);
+                    updateDownloadStatus(decoded_len, cfile);
+                    storeDecodedData(buf ? buf : decoded, decoded_len, false, cfile, imap_ctx);
+                }
+            }
+        }
+
+        void completeContent(imap_file_ctx &cfile, imap_context *imap_ctx)
+        {
+            cfile.progress.value = 100.0f;
+            cfile.progress.last_value = -1;
+            if (imap_ctx->digest.isActive())
+                imap_ctx->digest.finish(cfile.info.md5, cfile.info.sha256);
+            storeDecodedData(nullptr, 0, true, cfile, imap_ctx);
+            std::vector<uint8_t>().swap(imap_ctx->text_buf);
+#if defined(ENABLE_FS)
+            closeFile(imap_ctx);
+            commitCheckpoint(imap_ctx, cfile);
+#endif
+        }
+
+        void clear(String &s) { s.remove(0, s.length()); }
+
         void updateDownloadStatus(int len, imap_file_ctx &cfile)
         {
             cfile.decoded_len += len;
-            cfile.progress.value = (float)(cfile.total_read * 100) / (float)cfile.octet_count;
+            // The BINARY octets are counted against the (estimated) decoded size.
+            uint32_t size = cfile.binary && cfile.info.fileSize ? cfile.info.fileSize : cfile.octet_count;
+            cfile.progress.value = (float)(cfile.total_read * 100) / (float)size;
             if (cfile.progress.value > 100.0f)
                 cfile.progress.value = 100.0f;
         }
@@ -948,7 +1683,7 @@ namespace ReadyMailIMAP
         }
 
 #if defined(ENABLE_FS)
-        void openFile(imap_context *imap_ctx, imap_file_ctx &cfile)
+        void openFile(imap_context *imap_ctx, imap_file_ctx &cfile, bool append = false)
         {
             cfile.filepath.remove(0, cfile.filepath.length());
             rd_print_to(cfile.filepath, 200, "/%d/%s", imap_ctx->options.fetch_number, cfile.info.filename.c_str());
@@ -977,23 +1712,66 @@ namespace ReadyMailIMAP
 
                 path += cfile.filepath;
 
-                if (cfile.fileCallback)
-                {
-                    cfile.fileCallback(imap_ctx->file, path.c_str(), readymail_file_mode_remove);
-                    cfile.fileCallback(imap_ctx->file, path.c_str(), readymail_file_mode_open_write);
-                }
-                else if (imap_ctx->cb.file)
+                FileCallback cb = cfile.fileCallback ? cfile.fileCallback : imap_ctx->cb.file;
+                if (append)
+                    cb(imap_ctx->file, path.c_str(), readymail_file_mode_open_append);
+                else
                 {
-                    imap_ctx->cb.file(imap_ctx->file, path.c_str(), readymail_file_mode_remove);
-                    imap_ctx->cb.file(imap_ctx->file, path.c_str(), readymail_file_mode_open_write);
+                    cb(imap_ctx->file, path.c_str(), readymail_file_mode_remove);
+                    cb(imap_ctx->file, path.c_str(), readymail_file_mode_open_write);
                 }
+
+                imap_file_sink_ctx &sink = imap_ctx->file_sink;
+                sink.buf.clear();
+                sink.buf.reserve(sink.block_size);
+                sink.blocks = 0;
             }
         }
 
         void closeFile(imap_context *imap_ctx)
         {
             if (imap_ctx->file)
+            {
+                flushFile(imap_ctx);
                 imap_ctx->file.close();
+            }
+            std::vector<uint8_t>().swap(imap_ctx->file_sink.buf);
+        }
+
+        // Write the decoded data to file buffer, the buffer is written to file before it overflows
+        // so that the file ends at the decoded data boundary that the checkpoint can be committed.
+        void writeFile(imap_context *imap_ctx, imap_file_ctx &cfile, const uint8_t *data, int len)
+        {
+            imap_file_sink_ctx &sink = imap_ctx->file_sink;
+            if (sink.buf.size() + len > sink.block_size)
+            {
+                flushFile(imap_ctx);
+                commitCheckpoint(imap_ctx, cfile);
+            }
+
+            if ((size_t)len >= sink.block_size)
+                writeBlock(imap_ctx, data, len);
+            else
+                sink.buf.insert(sink.buf.end(), data, data + len);
+        }
+
+        void flushFile(imap_context *imap_ctx)
+        {
+            imap_file_sink_ctx &sink = imap_ctx->file_sink;
+            if (sink.buf.size())
+                writeBlock(imap_ctx, sink.buf.data(), sink.buf.size());
+            sink.buf.clear();
+        }
+
+        void writeBlock(imap_context *imap_ctx, const uint8_t *data, size_t len)
+        {
+            imap_file_sink_ctx &sink = imap_ctx->file_sink;
+            imap_ctx->file.write(data, len);
+            if (sink.sync_blocks > 0 && ++sink.blocks >= sink.sync_blocks)
+            {
+                sink.blocks = 0;
+                imap_ctx->file.flush();
+            }
         }
 #endif
 
@@ -1009,35 +1787,19 @@ namespace ReadyMailIMAP
                     cfile.section = cpart.section;
 
                     cfile.octet_count = getField(cpart, non_multipart_field_size).toInt();
-
                     cfile.info.transferEncoding = getField(cpart, non_multipart_field_encoding);
-                    if (cfile.info.transferEncoding == "quoted-printable")
-                        cfile.transfer_encoding = imap_transfer_encoding_quoted_printable;
-                    else if (cfile.info.transferEncoding == "base64")
-                        cfile.transfer_encoding = imap_transfer_encoding_base64;
-                    else if (cfile.info.transferEncoding == "7bit")
-                        cfile.transfer_encoding = imap_transfer_encoding_7bit;
-                    else if (cfile.info.transferEncoding == "8bit")
-                        cfile.transfer_encoding = imap_transfer_encoding_8bit;
-                    else if (cfile.info.transferEncoding == "binary")
-                        cfile.transfer_encoding = imap_transfer_encoding_binary;
-
                     cfile.info.mime = getField(cpart, non_multipart_field_type);
-                    cfile.text_part = cfile.info.mime == "text";
                     cfile.info.mime += "/";
                     cfile.info.mime += getField(cpart, non_multipart_field_subtype);
 
                     cfile.info.filename = getFileName(cpart);
-                    if (cfile.text_part)
-                    {
+                    if (getField(cpart, non_multipart_field_type) == "text")
                         cfile.info.charset = getCharset(cpart);
-                        cfile.char_encoding = getCharEncoding(cfile.info.charset);
-                    }
 
                     if (cfile.octet_count == 0)
                         cfile.octet_count = getOctetLen(line);
 
-                    if (cfile.transfer_encoding == imap_transfer_encoding_base64 || cfile.transfer_encoding == imap_transfer_encoding_binary)
+                    if (cfile.info.transferEncoding == "base64" || cfile.info.transferEncoding == "binary")
                     {
                         cfile.info.fileSize = numString.toNum(getPartFiled(cpart, non_multipart_field_disposition, "size", false).c_str());
                         if (cfile.info.fileSize == 0)
@@ -1046,13 +1808,43 @@ namespace ReadyMailIMAP
                     else if (getField(cpart, non_multipart_field_type) == "message")
                         cfile.info.fileSize = cfile.octet_count;
 
-                    if (imap_ctx->options.searching || cfile.info.fileSize > imap_ctx->options.part_size_limit || (cfile.info.fileSize == 0 && cfile.octet_count > imap_ctx->options.part_size_limit))
-                        cfile.fetch = false;
+                    setFileOptions(imap_ctx, cfile);
                     cmsg.files.push_back(cfile);
                 }
             }
         }
+
+        // Set the transfer encoding, character encoding and fetch option from the file info.
+        void setFileOptions(imap_context *imap_ctx, imap_file_ctx &cfile)
+        {
+            if (cfile.info.transferEncoding == "quoted-printable")
+                cfile.transfer_encoding = imap_transfer_encoding_quoted_printable;
+            else if (cfile.info.transferEncoding == "base64")
+                cfile.transfer_encoding = imap_transfer_encoding_base64;
+            else if (cfile.info.transferEncoding == "7bit")
+                cfile.transfer_encoding = imap_transfer_encoding_7bit;
+            else if (cfile.info.transferEncoding == "8bit")
+                cfile.transfer_encoding = imap_transfer_encoding_8bit;
+            else if (cfile.info.transferEncoding == "binary")
+                cfile.transfer_encoding = imap_transfer_encoding_binary;
+
+            cfile.text_part = cfile.info.mime.startsWith("text/");
+            if (cfile.text_part)
+                cfile.charset = getCharsetId(cfile.info.charset);
+
+            if (imap_ctx->options.searching || cfile.info.fileSize > imap_ctx->options.part_size_limit || (cfile.info.fileSize == 0 && cfile.octet_count > imap_ctx->options.part_size_limit))
+                cfile.fetch = false;
+        }
     };
+
+    inline void IMAPCallbackData::decodeHeader(int index)
+    {
+        if (parser && encodedHeaders && index > -1 && index < 16 && (*encodedHeaders & (1 << index)))
+        {
+            *encodedHeaders &= ~(1 << index);
+            parser->decodeHeader((*headers)[index]);
+        }
+    }
 }
 #endif
 #endif
\ No newline at end of file
@@ -491,6 +491,8 @@ namespace ReadyMailSMTP
         int value = 0;
         bool available = false;
         String filename;
+        // The lowercase hex digests of attachment data that are available when the value is 100, see SMTPClient::setDigest().
+        String md5, sha256;
     };
 
     typedef struct smtp_response_status_t
@@ -565,6 +567,8 @@ namespace ReadyMailSMTP
         String notify;
         bool last_append = false, ssl_mode = false, processing = false, accumulate = false, imap_mode = false, use_auto_client = false;
         int level = 0, data_len = 0;
+        uint8_t digest_types = readymail_digest_none;
+        readymail_wait_strategy wait;
     };
 
     struct smtp_cmd_ctx
@@ -580,11 +584,14 @@ namespace ReadyMailSMTP
 #if defined(ENABLE_READYCLIENT)
         ReadyClient *auto_client = nullptr;
 #endif
+        ReadyTLSSessionCache *tls_session_cache = nullptr;
         SMTPResponseCallback resp_cb = NULL;
         smtp_cmd_ctx cmd_ctx;
         SMTPStatus *status = nullptr;
         smtp_server_status_t *server_status = nullptr;
         smtp_options options;
+        // The digests of the attachment that is being sent.
+        ReadyDigest digest;
         uint32_t ts = 0;
     };
 
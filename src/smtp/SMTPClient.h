@@ -16,12 +16,17 @@
 using namespace ReadyMailSMTP;
 using namespace ReadyMailCallbackNS;
 
+class ReadyMailScheduler;
+class ReadyMailLoop;
+
 namespace ReadyMailSMTP
 {
 
     class SMTPClient
     {
         friend class IMAPSend;
+        friend class ::ReadyMailScheduler;
+        friend class ::ReadyMailLoop;
 
     private:
         SMTPConnection conn;
@@ -39,6 +44,10 @@ namespace ReadyMailSMTP
                 code = conn.loop();
                 if (code != function_return_failure)
                     code = sender.loop();
+                // The continue code is for awaiting the rest of server response.
+                if (code == function_return_continue)
+                    smtp_ctx.options.wait.wait(smtp_ctx.client, smtp_ctx.client);
+                rd_await_step(this);
             }
             smtp_ctx.server_status->state_info.state = smtp_state_prompt;
             sender.local_msg.clear();
@@ -366,6 +375,40 @@ namespace ReadyMailSMTP
             conn.begin(&smtp_ctx, tlsCallback, &res);
         }
 
+        /** Set the digests to compute from the attachment data that are being sent.
+         *
+         * @param types The bits of readymail_digest_type e.g. readymail_digest_md5 | readymail_digest_sha256, readymail_digest_none to disable (default).
+         *
+         * The digests of attachment data (before transfer encoding) are computed while the attachment is encoded
+         * and are available from SMTPStatus::progress.md5 and SMTPStatus::progress.sha256 when the progress value is 100.
+         */
+        void setDigest(uint8_t types) { smtp_ctx.options.digest_types = types; }
+
+        /** Set the TLS session cache for the session resumption.
+         *
+         * @param cache The ReadyTLSSessionCache class object that can be shared by many clients.
+         *
+         * The cached session of host and port is applied to the SSL client before the TLS handshake (in connect() of SSL client,
+         * TLSHandshakeCallback function or STARTTLS) and it is updated when the service is ready, the session resumption
+         * skips the full handshake. When this is not set, the session cache of ReadyClient is used.
+         */
+        void setTLSSessionCache(ReadyTLSSessionCache &cache) { smtp_ctx.tls_session_cache = &cache; }
+
+        /** Set how the blocking (await) operations wait for the server response.
+         *
+         * @param mode The readymail_wait_mode e.g. readymail_wait_yield (default), readymail_wait_sleep or readymail_wait_callback.
+         * @param timeoutMs The timeout hint in milliseconds that is slept or provided to the WaitCallback function. The default is 10 ms.
+         * @param cb Optional. The WaitCallback function that is used with readymail_wait_callback mode.
+         *
+         * The wait starts only when the server response is pending and no data is available, the read timeout is still applied.
+         */
+        void setWaitStrategy(readymail_wait_mode mode, uint32_t timeoutMs = 10, WaitCallback cb = NULL)
+        {
+            smtp_ctx.options.wait.mode = mode;
+            smtp_ctx.options.wait.timeout = timeoutMs;
+            smtp_ctx.options.wait.cb = cb;
+        }
+
         /** Provides the SMTP status information.
          *
          * @return SMTPStatus class object.
@@ -27,6 +27,7 @@ namespace ReadyMailSMTP
         uint16_t port = 0;
         ReadyTimer conn_timer;
         bool authenticating = false;
+        ReadyTLSSessionState tls_session;
 
         bool connectImpl()
         {
@@ -45,9 +46,18 @@ namespace ReadyMailSMTP
                 return false;
 
             smtp_ctx->options.processing = true;
+
+            // The SSL client performs the handshake in connect() when the TLS upgrade is not used.
+            tls_session.reset();
+            bool handshake = smtp_ctx->options.ssl_mode && !smtp_ctx->server_status->start_tls && !tls_cb;
+            if (handshake)
+                applyTLSSession();
+
             serverStatus() = smtp_ctx->client->connect(host.c_str(), port);
             if (!serverStatus())
             {
+                if (handshake)
+                    tls_session.fail();
                 stop(conn_timer.remaining() == 0);
                 if (smtp_ctx->resp_cb)
                     setError(__func__, conn_timer.remaining() == 0 ? TCP_CLIENT_ERROR_CONNECTION_TIMEOUT : TCP_CLIENT_ERROR_CONNECTION);
@@ -195,6 +205,7 @@ namespace ReadyMailSMTP
                     else
                     {
                         smtp_ctx->server_status->server_greeting_ack = true;
+                        tls_session.store();
                         ret = function_return_exit;
                         smtp_ctx->options.processing = false;
 #if defined(ENABLE_DEBUG)
@@ -293,6 +304,7 @@ namespace ReadyMailSMTP
 #if defined(ENABLE_DEBUG)
                 setDebugState(smtp_state_start_tls, "Performing TLS handshake...");
 #endif
+                applyTLSSession();
 #if defined(ENABLE_READYCLIENT)
                 if (smtp_ctx->auto_client && smtp_ctx->options.use_auto_client)
                     smtp_ctx->server_status->secured = smtp_ctx->auto_client->connectSSL();
@@ -311,7 +323,31 @@ namespace ReadyMailSMTP
 #endif
                 }
                 else
+                {
+                    tls_session.fail();
                     setError(__func__, TCP_CLIENT_ERROR_TLS_HANDSHAKE);
+                }
+            }
+        }
+
+        ReadyTLSSessionCache *tlsSessionCache()
+        {
+#if defined(ENABLE_READYCLIENT)
+            if (!smtp_ctx->tls_session_cache && smtp_ctx->auto_client && smtp_ctx->options.use_auto_client)
+                return smtp_ctx->auto_client->getSessionCache();
+#endif
+            return smtp_ctx->tls_session_cache;
+        }
+
+        // Apply the cached TLS session of server before the handshake, the session is stored when the service is ready.
+        // The session is only used for the SSL connection (SSL or STARTTLS), the plain connection has no session.
+        void applyTLSSession()
+        {
+            if (tls_session.apply(smtp_ctx->options.ssl_mode ? tlsSessionCache() : nullptr, smtp_ctx->client, host, port))
+            {
+#if defined(ENABLE_DEBUG)
+                setDebugState(smtp_state_start_tls, "Resuming the TLS session...");
+#endif
             }
         }
 
@@ -672,6 +672,9 @@ namespace ReadyMailSMTP
                             setDebugState(smtp_state_send_body, str);
 #endif
 
+                        smtp_ctx->digest.begin(smtp_ctx->options.digest_types);
+                        smtp_ctx->status->progress.md5.remove(0, smtp_ctx->status->progress.md5.length());
+                        smtp_ctx->status->progress.sha256.remove(0, smtp_ctx->status->progress.sha256.length());
                         updateUploadStatus(cAttach(msg));
 
                         String buf, ct_prop;
@@ -765,6 +768,13 @@ namespace ReadyMailSMTP
                     String buf;
 
                     cAttach(msg).data_index += read;
+                    if (read > 0)
+                        smtp_ctx->digest.update(readBuf, read);
+
+                    // The digests are provided with the last progress status.
+                    if (cAttach(msg).data_index >= cAttach(msg).data_size && smtp_ctx->digest.isActive())
+                        smtp_ctx->digest.finish(smtp_ctx->status->progress.md5, smtp_ctx->status->progress.sha256);
+
                     updateUploadStatus(cAttach(msg));
 
                     if (cAttach(msg).content_encoding != cAttach(msg).transfer_encoding)